@@ -0,0 +1,55 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../vendor/HandmadeMath/HandmadeMath.h"
+
+// Scene time advances by a fixed step per rendered frame instead of the wall clock,
+// so every run renders exactly the same frames no matter how fast the device is.
+#define BENCH_TIME_STEP (1.0 / 60.0)
+#define BENCH_DEFAULT_WARMUP 30
+
+typedef struct {
+    double cpuMs; // wall time between the end of the previous frame and this one
+    double gpuMs; // first to last timestamp of the frame, < 0 if it was never collected
+} BenchFrame;
+
+typedef struct {
+    bool enabled;
+    uint32_t frameCount;   // measured frames, 0 = measure for duration seconds
+    double duration;
+    uint32_t warmupFrames; // rendered before measuring, not recorded
+    const char* outputPath; // .json writes json, anything else csv
+
+    // written into the report
+    const char* deviceName;
+    const char* presentMode;
+    const char* antiAliasing;
+    uint32_t width;
+    uint32_t height;
+    uint32_t framesInFlight;
+
+    uint64_t frame; // rendered frames including warmup
+    uint64_t startNs;
+    uint64_t lastFrameNs;
+
+    BenchFrame* frames;
+    uint32_t recordedCount;
+    uint32_t capacity;
+} Benchmark;
+
+bool benchBegin(Benchmark* bench);
+double benchSceneTime(const Benchmark* bench);
+void benchCameraPath(double time, HMM_Vec3* position, HMM_Vec3* target);
+
+// frame is the value of bench->frame when the frame was recorded
+void benchRecordGpuTime(Benchmark* bench, uint64_t frame, double gpuMs);
+
+// Call once per rendered frame. Returns true when the benchmark is complete.
+bool benchEndFrame(Benchmark* bench);
+void benchFinish(Benchmark* bench);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "trace.h"
+
+#define CPU_PROFILER_RING_SIZE 4096 // events per thread, power of two
+#define CPU_PROFILER_MAX_DEPTH 32
+#define CPU_PROFILER_MAX_THREADS 64
+#define CPU_PROFILER_MAX_PHASES 64
+
+// Statistics of one phase over the window, a phase is every scope with the same name.
+// Each sample is the phase's total time in one frame, frames without it are not counted.
+typedef struct {
+    const char* name;
+    uint32_t samples;
+    double avgMs;
+    double p50Ms;
+    double p95Ms;
+    double p99Ms;
+    double maxMs;
+} CpuPhaseStats;
+
+// Scopes are no-ops until the profiler is initialized. windowFrames is the
+// number of frames the statistics are computed over, 0 keeps every frame.
+void cpuProfilerInit(uint32_t windowFrames);
+void cpuProfilerShutdown(void);
+void cpuProfilerSetThreadName(const char* name);
+
+// Any thread, names are not copied (use string literals). Each thread records into its
+// own ring buffer, so there is no locking except the first time a thread records.
+void cpuProfilerBeginScope(const char* name);
+void cpuProfilerEndScope(void);
+
+// From one thread once per frame: drains the ring buffers of all threads, adds the frame
+// to the statistics window (plus a "frame" phase for the whole frame) and writes the
+// events to the trace (may be NULL).
+void cpuProfilerEndFrame(TraceWriter* trace);
+
+// Drops the frames collected so far from the statistics, e.g. once a warmup is over
+void cpuProfilerResetStats(void);
+
+uint32_t cpuProfilerGetStats(CpuPhaseStats* stats, uint32_t maxStats);
+void cpuProfilerPrintStats(FILE* file);
+
+#endif
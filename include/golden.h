@@ -0,0 +1,23 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Compares rendered frames against stored reference images. Alpha is ignored,
+// the swapchain is presented opaque.
+typedef struct {
+    bool compared;             // the golden image was loaded and has the frame's size
+    uint32_t totalPixels;
+    uint32_t mismatchedPixels; // pixels with a channel off by more than the tolerance
+    uint32_t maxDifference;    // largest channel difference, 0..255
+    double meanDifference;     // average channel difference
+} GoldenResult;
+
+bool writePng(const char* path, const uint8_t* rgba, uint32_t width, uint32_t height);
+
+// diffPath is optional: mismatched pixels are written red over a darkened copy of the frame
+GoldenResult compareWithGolden(const char* goldenPath, const uint8_t* rgba, uint32_t width, uint32_t height,
+                               uint32_t tolerance, const char* diffPath);
+
+#endif
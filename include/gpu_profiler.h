@@ -0,0 +1,83 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include "vulkan_base.h"
+#include "trace.h"
+
+#define GPU_PROFILER_MAX_DEPTH 16
+#define GPU_PROFILER_INITIAL_QUERIES 64
+
+typedef struct {
+    const char* name; // not copied, use string literals
+    uint32_t depth;
+    uint32_t beginQuery;
+    uint32_t endQuery; // UINT32_MAX while the scope is open or if it ran out of queries
+} GpuProfilerScope;
+
+// Scopes recorded by one frame slot. The query pool is reused once the slot's
+// previous submission finished and grows when a frame needed more queries.
+typedef struct {
+    VkQueryPool queryPool;
+    uint64_t* queryResults; // value + availability per query
+    uint32_t queryCapacity;
+    uint32_t queryCount;
+    bool overflowed;
+
+    GpuProfilerScope* scopes;
+    uint32_t scopeCount;
+    uint32_t scopeCapacity;
+
+    uint32_t openScopes[GPU_PROFILER_MAX_DEPTH];
+    uint32_t openCount;
+
+    bool pending; // submitted, results not collected yet
+    uint64_t submitTimeNs;
+} GpuProfilerFrame;
+
+typedef struct {
+    const char* name;
+    uint32_t depth;
+    double startMs; // relative to the first timestamp of the frame
+    double durationMs;
+} GpuProfilerResult;
+
+typedef struct {
+    VulkanContext* context;
+    bool enabled;           // false if the graphics queue has no timestamp support
+    double timestampPeriod; // ns per tick
+    uint64_t timestampMask;
+
+    GpuProfilerFrame* frames;
+    uint32_t frameCount;
+    uint32_t currentFrame;
+
+    // gpu tick <-> CLOCK_MONOTONIC pair from VK_EXT_calibrated_timestamps
+    bool calibrated;
+    uint64_t calibrationGpuTicks;
+    uint64_t calibrationHostNs;
+
+    // last collected frame
+    GpuProfilerResult* results;
+    uint32_t resultCount;
+    uint32_t resultCapacity;
+    double frameTimeMs;
+    uint32_t droppedFrames;
+} GpuProfiler;
+
+void createGpuProfiler(VulkanContext* context, GpuProfiler* profiler, uint32_t frameCount);
+void destroyGpuProfiler(GpuProfiler* profiler);
+
+// Call after the frame slot's previous submission finished, before recording into commandBuffer
+void gpuProfilerBeginFrame(GpuProfiler* profiler, uint32_t frameIndex, VkCommandBuffer commandBuffer);
+// Scopes nest and may be spread over several command buffers submitted for the frame
+void gpuProfilerBeginScope(GpuProfiler* profiler, VkCommandBuffer commandBuffer, const char* name);
+void gpuProfilerEndScope(GpuProfiler* profiler, VkCommandBuffer commandBuffer);
+// Call right before submitting the frame
+void gpuProfilerEndFrame(GpuProfiler* profiler);
+
+// Reads the results of the frame slot without waiting. Returns false if there are none
+// or they are not available yet; otherwise fills results/frameTimeMs and writes the
+// scopes to the trace (may be NULL).
+bool gpuProfilerCollect(GpuProfiler* profiler, uint32_t frameIndex, TraceWriter* trace);
+
+#endif
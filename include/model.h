@@ -5,10 +5,12 @@
 #include "vulkan_base.h"
 
 typedef struct {
-    VulkanBuffer vertexBuffer;
-    VulkanBuffer indexBuffer;
+    VulkanBufferHandle vertexBuffer;
+    VulkanBufferHandle indexBuffer;
     uint64_t numIndices;
-    VulkanImage albedoTexture; // color texture
+    VulkanImageHandle albedoTexture; // color texture
+    float baseColorFactor[4];  // multiplied with the albedo texture
+    VulkanSamplerDesc albedoSampler; // the glTF sampler of the albedo texture
 } Model;
 
 Model createModel(VulkanContext* context, const char* filepath);
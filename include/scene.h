@@ -0,0 +1,90 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "../vendor/HandmadeMath/HandmadeMath.h"
+#include "transform.h"
+
+#define SCENE_NO_PARENT UINT32_MAX
+#define SCENE_INVALID_NODE UINT32_MAX
+#define SCENE_MAX_THREADS 16
+#define SCENE_PARALLEL_MIN_NODES 16384 // smaller scenes are updated on the calling thread
+#define SCENE_MIN_BATCH 256           // nodes per thread and level before another thread joins in
+
+// Stable id of a node, the arrays below are reordered when the hierarchy is sorted
+typedef uint32_t SceneNode;
+
+// The hierarchy is stored as parallel arrays in breadth first order: sorted by depth, the
+// children of one parent next to each other and parents before their children. One level
+// then only reads the worlds of the level above, and runs of siblings multiply by the same
+// parent world.
+typedef struct {
+    uint32_t count;
+    uint32_t capacity;
+
+    // indexed by sorted position
+    uint32_t* parents; // sorted position of the parent, SCENE_NO_PARENT for roots
+    uint32_t* depths;
+    SceneNode* nodes;  // id of the node at each position
+    HMM_Mat4* locals;
+    HMM_Mat4* worlds;
+    HMM_Mat4* modelViews;
+    HMM_Mat4* modelViewProjs;
+    NormalMatrix* normalMatrices;
+    uint8_t* dirty; // local changed since the last update, spreads to the subtree while updating
+
+    uint32_t* positions; // indexed by SceneNode
+    uint32_t* levelStarts; // levelCount + 1 entries into the sorted arrays
+    uint32_t levelCount;
+    bool sorted;
+
+    HMM_Mat4 view;
+    HMM_Mat4 viewProj;
+    bool viewValid; // view and viewProj were used by an update, unchanged ones skip clean nodes
+
+    // updateScene runs on the calling thread and threadCount - 1 workers, which
+    // meet at the barrier to start, after every level and at the end
+    uint32_t threadCount;
+    pthread_t workers[SCENE_MAX_THREADS];
+    pthread_barrier_t barrier;
+    bool quit;
+    bool viewChanged;
+    uint32_t participants; // threads sharing the current update
+    _Atomic uint32_t nextPart; // workers take their share of the update from here, the caller has part 0
+} Scene;
+
+// threadCount 0 uses one thread per online cpu
+bool createScene(Scene* scene, uint32_t capacity, uint32_t threadCount);
+void destroyScene(Scene* scene);
+
+// parent must already be in the scene, SCENE_NO_PARENT adds a root. Returns SCENE_INVALID_NODE
+// when the arrays can not grow.
+SceneNode sceneAddNode(Scene* scene, SceneNode parent, const HMM_Mat4* local);
+void sceneSetLocal(Scene* scene, SceneNode node, const HMM_Mat4* local);
+
+// Recomputes the worlds of changed subtrees, and the view transforms of those nodes or of every
+// node when the view changed. Needs no other synchronization than not running concurrently with
+// itself or the setters.
+void updateScene(Scene* scene, const HMM_Mat4* view, const HMM_Mat4* viewProj);
+
+static inline const HMM_Mat4* sceneGetWorld(const Scene* scene, SceneNode node) {
+    return &scene->worlds[scene->positions[node]];
+}
+
+static inline const HMM_Mat4* sceneGetModelView(const Scene* scene, SceneNode node) {
+    return &scene->modelViews[scene->positions[node]];
+}
+
+static inline const HMM_Mat4* sceneGetModelViewProj(const Scene* scene, SceneNode node) {
+    return &scene->modelViewProjs[scene->positions[node]];
+}
+
+static inline const NormalMatrix* sceneGetNormalMatrix(const Scene* scene, SceneNode node) {
+    return &scene->normalMatrices[scene->positions[node]];
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+// Summary of a set of timings in milliseconds, percentiles use the nearest rank
+typedef struct {
+    uint32_t samples;
+    double avgMs;
+    double minMs;
+    double p50Ms;
+    double p95Ms;
+    double p99Ms;
+    double maxMs;
+} SampleStats;
+
+// Sorts values in place. No values give zeroed stats.
+SampleStats computeSampleStats(double* values, uint32_t count);
+
+// p in [0, 1] on values sorted ascending, count must not be 0
+double percentile(const double* sorted, uint32_t count, double p);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+// All timestamps are CLOCK_MONOTONIC nanoseconds, see traceNowNs.
+#define TRACE_PID 1
+#define TRACE_TID_GPU 1000 // the graphics queue is shown as its own track
+
+typedef struct {
+    FILE* file;
+    bool firstEvent;
+} TraceWriter;
+
+uint64_t traceNowNs(void);
+bool traceOpen(TraceWriter* writer, const char* path);
+void traceClose(TraceWriter* writer);
+void traceWriteComplete(TraceWriter* writer, const char* name, const char* category,
+                        uint32_t tid, uint64_t startNs, uint64_t durationNs);
+void traceWriteThreadName(TraceWriter* writer, uint32_t tid, const char* name);
+
+#endif
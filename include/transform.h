@@ -0,0 +1,24 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <stdint.h>
+
+#include "../vendor/HandmadeMath/HandmadeMath.h"
+
+// mat3 as laid out in std140/std430 blocks and push constants: three columns padded to vec4
+typedef struct {
+    float columns[3][4];
+} NormalMatrix;
+
+// Inverse transpose of the upper 3x3 of modelView, transforms normals into view space.
+// A singular matrix gives a zero matrix.
+NormalMatrix computeNormalMatrix(const HMM_Mat4* modelView);
+
+// Same for count matrices, four at a time with SSE when available
+void computeNormalMatrices(const HMM_Mat4* modelViews, NormalMatrix* normalMatrices, uint32_t count);
+
+// results[i] = left * rights[i], with SSE the columns of left stay in registers for the whole batch.
+// results may be rights, not left.
+void multiplyMatrices(const HMM_Mat4* left, const HMM_Mat4* rights, HMM_Mat4* results, uint32_t count);
+
+#endif
@@ -2,6 +2,7 @@
 #ifndef VULKAN_BASE_H
 #define VULKAN_BASE_H
 
+#include <stdio.h>
 #include <stdbool.h>
 
 #include <vulkan/vulkan.h>
@@ -12,9 +13,19 @@
 
 #define ARRAY_COUNT(a) (sizeof(a) / sizeof((a)[0]))
 
+// upper bound of optional extensions createLogicalDevice may add to the required ones
+#define MAX_OPTIONAL_DEVICE_EXTENSIONS 8
+
+// FNV-1a, start value of hashBytes
+#define VULKAN_HASH_SEED 0xcbf29ce484222325ull
+
 typedef struct {
     VkQueue queue;
     uint32_t familyIndex;
+
+    // signaled with an increasing value by every submission to this queue
+    VkSemaphore timeline;
+    uint64_t timelineValue; // last submitted value
 } VulkanQueue;
 
 typedef struct {
@@ -27,72 +38,522 @@ typedef struct {
     uint32_t width;
     uint32_t height;
     VkFormat format;
+    VkPresentModeKHR presentMode;
+    VkImageUsageFlags usage; // requested usage minus what the surface does not support
 } VulkanSwapchain;
 
+// How a pipeline receives its per draw data (transforms, material ids, ...): push constants
+// when size fits into maxPushConstantsSize, otherwise a dynamic uniform buffer at binding 0 of
+// descriptor set `set` whose data is bump allocated per draw from a VulkanFrameAllocator.
+typedef struct {
+    uint32_t size;
+    VkShaderStageFlags stages;
+    uint32_t set;
+    bool pushConstants;
+} VulkanDrawDataLayout;
+
 typedef struct {
     VkPipeline pipeline;
     VkPipelineLayout layout;
+    VulkanDrawDataLayout drawData; // size 0 without per draw data
 } VulkanPipeline;
 
+// Attachments a pipeline renders to. The formats are only needed with dynamic rendering,
+// a render pass describes them itself, the sample count is needed for both.
+typedef struct {
+    VkFormat colorFormat;
+    VkFormat depthFormat; // VK_FORMAT_UNDEFINED without depth buffer
+    VkSampleCountFlagBits sampleCount;
+} VulkanRenderingFormats;
+
+// Everything a sampler is created from. Zero initialized it filters nearest and repeats.
+typedef struct {
+    VkFilter magFilter;
+    VkFilter minFilter;
+    VkSamplerMipmapMode mipmapMode;
+    VkSamplerAddressMode addressModeU;
+    VkSamplerAddressMode addressModeV;
+    VkSamplerAddressMode addressModeW;
+    float maxAnisotropy; // <= 1 is off, clamped to maxSamplerAnisotropy
+    float maxLod;        // 0 = VK_LOD_CLAMP_NONE
+} VulkanSamplerDesc;
+
+typedef struct {
+    VulkanSamplerDesc desc; // after clamping to the device, see getSampler
+    VkSampler sampler;
+} VulkanSamplerEntry;
+
+// Samplers by their description, they live until exitVulkan. Devices only allow a few thousand
+// samplers (maxSamplerAllocationCount) and materials mostly use the same handful of settings.
+typedef struct {
+    VulkanSamplerEntry* entries;
+    uint32_t count;
+    uint32_t capacity;
+} VulkanSamplerCache;
+
+typedef enum {
+    VULKAN_BLEND_NONE,  // opaque geometry, the color is written as is
+    VULKAN_BLEND_ALPHA, // src alpha over the attachment
+} VulkanBlendMode;
+
+// Every state a graphics pipeline is created from. Start from defaultPipelineDesc() and set what
+// differs. Arrays and strings are hashed by their contents, so descriptions filled from different
+// arrays still share one pipeline, and the pointers only have to live during acquirePipeline.
+typedef struct {
+    const char* vertPath;
+    const char* fragPath;
+    const VkSpecializationInfo* fragSpecialization;
+
+    const VkVertexInputAttributeDescription* attributes;
+    uint32_t attributeCount;
+    const VkVertexInputBindingDescription* binding; // NULL without vertex buffers
+
+    const VkDescriptorSetLayout* setLayouts;
+    uint32_t setLayoutCount;
+    const VkPushConstantRange* pushConstant;
+    const VulkanDrawDataLayout* drawData;
+
+    VkPrimitiveTopology topology;
+    VkPolygonMode polygonMode;
+    VkCullModeFlags cullMode;
+    VkFrontFace frontFace;
+    bool depthTest;
+    bool depthWrite;
+    VkCompareOp depthCompareOp;
+    VulkanBlendMode blend;
+
+    VkRenderPass renderPass; // VK_NULL_HANDLE renders with dynamic rendering to the formats
+    VulkanRenderingFormats formats;
+} VulkanPipelineDesc;
+
+// What an allocation is used for, memory is accounted per category (vulkan_memory.c)
+typedef enum {
+    VULKAN_MEMORY_GEOMETRY,
+    VULKAN_MEMORY_TEXTURE,
+    VULKAN_MEMORY_RENDER_TARGET,
+    VULKAN_MEMORY_STAGING,
+    VULKAN_MEMORY_UNIFORM,
+    VULKAN_MEMORY_CATEGORY_COUNT,
+} VulkanMemoryCategory;
+
+// Each buffer and image owns its allocation, the size and type are kept to untrack it
+typedef struct {
+    VkDeviceSize size;
+    uint32_t memoryTypeIndex;
+    VulkanMemoryCategory category;
+} VulkanAllocationInfo;
+
 typedef struct {
     VkBuffer buffer;
     VkDeviceMemory memory;
+    VulkanAllocationInfo allocation;
+    uint64_t lastUse; // graphics queue timeline value of the last submission using it
 } VulkanBuffer;
 
 typedef struct {
     VkImage image;
     VkImageView view;
     VkDeviceMemory memory;
+    VulkanAllocationInfo allocation;
+    uint64_t lastUse; // graphics queue timeline value of the last submission using it
 } VulkanImage;
 
+// 32 bit handle of a pooled resource: the slot index in the low VULKAN_HANDLE_INDEX_BITS bits and
+// the slot's generation above. Releasing a slot changes its generation, so a handle that outlived
+// its resource is detected instead of silently using whatever took the slot. 0 is never valid.
+#define VULKAN_HANDLE_INDEX_BITS 20
+#define VULKAN_HANDLE_MAX_SLOTS (1u << VULKAN_HANDLE_INDEX_BITS)
+#define VULKAN_HANDLE_GENERATION_MASK ((1u << (32 - VULKAN_HANDLE_INDEX_BITS)) - 1)
+
+typedef struct {
+    uint32_t value;
+} VulkanBufferHandle;
+
+typedef struct {
+    uint32_t value;
+} VulkanImageHandle;
+
+// Slot bookkeeping of a pool, the resources live in an array next to it indexed by slot.
+// Released slots are reused first so the array stays dense.
+typedef struct {
+    uint16_t* generations;
+    uint32_t* freeSlots;
+    uint32_t freeCount;
+    uint32_t slotCount; // slots handed out at least once
+    uint32_t capacity;
+    uint32_t liveCount;
+} VulkanHandlePool;
+
+typedef struct {
+    VulkanHandlePool handles;
+    VulkanBuffer* buffers;
+} VulkanBufferPool;
+
+typedef struct {
+    VulkanHandlePool handles;
+    VulkanImage* images;
+} VulkanImagePool;
+
+// One host visible buffer of a readback ring. A slot is busy from the copy until the
+// caller released it, its data is valid once the graphics timeline reached readyValue.
+typedef struct {
+    VulkanBuffer buffer;
+    void* mapped;
+    VkDeviceSize size;
+
+    uint32_t width;
+    uint32_t height;
+    VkFormat format;
+    uint64_t tag;        // caller's id of the copied image, e.g. the frame number
+    uint64_t readyValue; // submit value of the copy, 0 until the caller submitted it
+    bool busy;
+} VulkanReadbackSlot;
+
+typedef struct {
+    VulkanReadbackSlot* slots;
+    uint32_t slotCount;
+    uint32_t oldest;    // slots are filled and completed in order
+    uint32_t busyCount;
+} VulkanReadbackRing;
+
+// One persistently mapped buffer split into a region per frame in flight. Per draw data is
+// bump allocated into the current frame's region and bound with dynamic offsets, the region
+// is reused once the frame slot's previous submission finished.
+typedef struct {
+    VulkanBuffer buffer;
+    uint8_t* mapped;
+    VkDeviceSize frameSize;
+    VkDeviceSize alignment; // of every allocation, satisfies the dynamic uniform and storage offset limits
+    uint32_t frameCount;
+
+    VkDeviceSize frameBase; // start of the current frame's region
+    VkDeviceSize used;      // bytes of the current frame's region
+    VkDeviceSize peakUsed;
+    bool overflowed;        // an allocation did not fit, reported once
+} VulkanFrameAllocator;
+
+#define VULKAN_DESCRIPTOR_INITIAL_SETS_PER_POOL 32
+#define VULKAN_DESCRIPTOR_MAX_SETS_PER_POOL 4096
+
+// Descriptor pools chained as they fill up. Sets are never freed one by one, the allocator
+// is reset as a whole: a persistent allocator lives as long as its sets, a per frame one is
+// reset when its frame slot is reused. After the first frames no pools are created anymore.
+// Zero initialized it is ready to use.
+typedef struct {
+    VkDescriptorPool* pools;
+    uint32_t poolCount;
+    uint32_t poolCapacity;
+    uint32_t currentPool;  // the pools before it are full
+    uint32_t setsPerPool;  // of the next pool, doubles up to VULKAN_DESCRIPTOR_MAX_SETS_PER_POOL
+} VulkanDescriptorAllocator;
+
+typedef struct {
+    uint64_t hash;
+    uint32_t bindingCount;
+    VkDescriptorSetLayoutBinding* bindings; // sorted by binding, immutable samplers copied
+    VkDescriptorSetLayout layout;
+    VkDescriptorUpdateTemplate updateTemplate; // created on first use
+} VulkanDescriptorLayoutEntry;
+
+// Element of the data passed to vkUpdateDescriptorSetWithTemplate: one per descriptor, in
+// binding order (sorted by binding number, array elements next to each other).
+typedef union {
+    VkDescriptorImageInfo image;
+    VkDescriptorBufferInfo buffer;
+    VkBufferView texelBuffer;
+} VulkanDescriptorInfo;
+
+// Descriptor set layouts by their bindings, equal bindings share one layout
+typedef struct {
+    VulkanDescriptorLayoutEntry* entries; // open addressing, capacity is a power of two
+    uint32_t count;
+    uint32_t capacity;
+} VulkanDescriptorLayoutCache;
+
+// A pipeline or pipeline layout of the registry, key is the serialized description it was created from
+typedef struct {
+    uint64_t hash;
+    uint8_t* key;
+    uint32_t keySize;
+    uint32_t references;
+    VulkanPipeline pipeline; // only the layout is set for layout entries
+} VulkanPipelineEntry;
+
+// Pipelines and pipeline layouts by their description: acquiring an existing one only adds a
+// reference, the last release destroys it once the gpu is done with it. Layouts are shared by
+// every pipeline with the same set layouts and push constants.
+typedef struct {
+    VulkanPipelineEntry* pipelines;
+    uint32_t pipelineCount;
+    uint32_t pipelineCapacity;
+
+    VulkanPipelineEntry* layouts;
+    uint32_t layoutCount;
+    uint32_t layoutCapacity;
+
+    uint32_t createdPipelines;
+    uint32_t reusedPipelines;
+} VulkanPipelineRegistry;
+
+#define VULKAN_BINDLESS_MAX_TEXTURES 1024
+#define VULKAN_BINDLESS_MAX_MATERIALS 1024
+
+// std430 element of the material storage buffer
+typedef struct {
+    float baseColorFactor[4];
+    uint32_t albedoTexture; // index into the texture array
+    uint32_t padding[3];
+} VulkanMaterial;
+
+// One descriptor set for every texture and material: a partially bound, update after bind
+// texture array and a storage buffer of materials. Draws pass a material index instead of
+// binding descriptors. Textures and materials are only appended, slots in use by frames in
+// flight are never rewritten.
+typedef struct {
+    VkDescriptorSetLayout layout;
+    VkDescriptorPool pool;
+    VkDescriptorSet set;
+
+    uint32_t textureCapacity;
+    uint32_t textureCount;
+
+    VulkanBuffer materialBuffer;
+    VulkanMaterial* materials; // mapped materialBuffer
+    uint32_t materialCapacity;
+    uint32_t materialCount;
+} VulkanBindless;
+
+typedef enum {
+    VULKAN_DELETION_BUFFER,
+    VULKAN_DELETION_IMAGE,
+    VULKAN_DELETION_FRAMEBUFFER,
+    VULKAN_DELETION_RENDER_PASS,
+    VULKAN_DELETION_SWAPCHAIN,
+    VULKAN_DELETION_PIPELINE,
+    VULKAN_DELETION_PIPELINE_LAYOUT,
+    VULKAN_DELETION_DESCRIPTOR_POOL,
+} VulkanDeletionType;
+
+// A resource that is destroyed once the graphics timeline reaches retireValue
+typedef struct {
+    VulkanDeletionType type;
+    uint64_t retireValue;
+    union {
+        VulkanBuffer buffer;
+        VulkanImage image;
+        VkFramebuffer framebuffer;
+        VkRenderPass renderPass;
+        VulkanSwapchain swapchain;
+        VulkanPipeline pipeline;
+        VkPipelineLayout pipelineLayout;
+        VkDescriptorPool descriptorPool;
+    } as;
+} VulkanDeletion;
+
+typedef struct {
+    VulkanDeletion* entries;
+    uint32_t count;
+    uint32_t capacity;
+} VulkanDeletionQueue;
+
+typedef struct {
+    VkDeviceSize bytes[VULKAN_MEMORY_CATEGORY_COUNT];
+    VkDeviceSize peakBytes[VULKAN_MEMORY_CATEGORY_COUNT];
+    uint32_t allocations[VULKAN_MEMORY_CATEGORY_COUNT];
+    VkDeviceSize heapBytes[VK_MAX_MEMORY_HEAPS];
+    bool heapWarned[VK_MAX_MEMORY_HEAPS]; // over the warning threshold, reset once usage dropped again
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+} VulkanMemoryTracker;
+
+typedef struct {
+    VkDeviceSize size;
+    VkDeviceSize budget;    // VK_EXT_memory_budget, the heap size without it
+    VkDeviceSize usage;     // of the whole process according to the driver, our allocations without the extension
+    VkDeviceSize allocated; // by createBuffer/createImage
+    bool deviceLocal;
+} VulkanHeapSnapshot;
+
+typedef struct {
+    VkDeviceSize categoryBytes[VULKAN_MEMORY_CATEGORY_COUNT];
+    VkDeviceSize categoryPeakBytes[VULKAN_MEMORY_CATEGORY_COUNT];
+    uint32_t categoryAllocations[VULKAN_MEMORY_CATEGORY_COUNT];
+    VulkanHeapSnapshot heaps[VK_MAX_MEMORY_HEAPS];
+    uint32_t heapCount;
+    bool hasBudget;
+} VulkanMemorySnapshot;
+
 typedef struct {
     VkInstance instance;
     VkPhysicalDevice physicalDevice;
     VkPhysicalDeviceProperties physicalDeviceProperties;
     VkDevice device;
+    VkPipelineCache pipelineCache; // shared by every pipeline created, mostly helps with shader variants
     VulkanQueue graphicsQueue;
     VkDebugUtilsMessengerEXT debugCallback;
+    VulkanDeletionQueue deletionQueue;
+
+    // VK_KHR_dynamic_rendering, optional
+    bool supportsDynamicRendering;
+    PFN_vkCmdBeginRenderingKHR cmdBeginRendering;
+    PFN_vkCmdEndRenderingKHR cmdEndRendering;
+
+    // VK_EXT_calibrated_timestamps with a CLOCK_MONOTONIC time domain, optional
+    bool supportsCalibratedTimestamps;
+    PFN_vkGetCalibratedTimestampsEXT getCalibratedTimestamps;
+
+    // VK_EXT_memory_budget, optional
+    bool supportsMemoryBudget;
+
+    // descriptor indexing features (core 1.2) needed by VulkanBindless, optional
+    bool supportsDescriptorIndexing;
+
+    // samplerAnisotropy, optional
+    bool supportsSamplerAnisotropy;
+
+    VulkanDescriptorLayoutCache descriptorLayoutCache;
+    VulkanPipelineRegistry pipelineRegistry;
+    VulkanSamplerCache samplerCache;
+    VulkanBufferPool bufferPool;
+    VulkanImagePool imagePool;
+    VulkanMemoryTracker memoryTracker;
 } VulkanContext;
 
+// enableValidation turns on VK_LAYER_KHRONOS_validation and the debug messenger, the
+// caller has to add VK_EXT_debug_utils and VK_EXT_validation_features to the instance extensions
 VulkanContext* initVulkan(uint32_t glfwExtensionCount, const char** glfwExtensions,
-        uint32_t deviceExtensionCount, const char** deviceExtensions);
+        uint32_t deviceExtensionCount, const char** deviceExtensions, bool enableValidation);
 
 // vulkan_device.c
-bool initVulkanInstance(VulkanContext* context, uint32_t glfwExtensionCount, const char** glfwExtensions);
+bool initVulkanInstance(VulkanContext* context, uint32_t glfwExtensionCount, const char** glfwExtensions, bool enableValidation);
 bool selectPhysicalDevice(VulkanContext* context);
 bool createLogicalDevice(VulkanContext* context, uint32_t deviceExtensionCount, const char** deviceExtensions);
 void exitVulkan(VulkanContext* context);
 VkDebugUtilsMessengerEXT registerDebugCallback(VkInstance instance);
 
 // vulkan_swapchain.c 
-VulkanSwapchain createSwapchain(GLFWwindow* window, VulkanContext* context, VkSurfaceKHR surface, VkImageUsageFlags usage, VulkanSwapchain* oldSwapchain);
+VulkanSwapchain createSwapchain(GLFWwindow* window, VulkanContext* context, VkSurfaceKHR surface, VkImageUsageFlags usage,
+        VkPresentModeKHR presentMode, uint32_t imageCount, VulkanSwapchain* oldSwapchain);
+const char* presentModeName(VkPresentModeKHR mode);
+bool parsePresentMode(const char* name, VkPresentModeKHR* mode);
 void destroySwapchain(VulkanContext* context, VulkanSwapchain* swapchain);
 
 // vulkan_renderpass.c 
-VkRenderPass createRenderPass(VulkanContext* context, VkFormat format, VkSampleCountFlagBits sampleCount);
+VkRenderPass createRenderPass(VulkanContext* context, VkFormat format, VkFormat depthFormat,
+        VkSampleCountFlagBits sampleCount, VkImageLayout finalLayout);
+VkFramebuffer createFramebuffer(VulkanContext* context, VkRenderPass renderPass, uint32_t attachmentCount,
+        VkImageView* attachments, uint32_t width, uint32_t height);
+VkFormat selectDepthFormat(VulkanContext* context, VkFormat preferred);
+VkSampleCountFlagBits selectSampleCount(VulkanContext* context, VkSampleCountFlagBits requested);
+bool isSampleCountSupported(VulkanContext* context, VkSampleCountFlagBits sampleCount);
 void destroyRenderPass(VulkanContext* context, VkRenderPass renderPass);
 
 // vulkan_pipeline.c 
 VkShaderModule createShaderModule(VulkanContext* context, const char* filepath);
-VulkanPipeline createPipeline(VulkanContext* context, const char* vertPath, const char* fragPath,
-        VkRenderPass renderPass, uint32_t width, uint32_t height,
-        VkVertexInputAttributeDescription* attributes, uint32_t numAttributes,
-        VkVertexInputBindingDescription* binding, uint32_t numSetLayouts,
-        VkDescriptorSetLayout* setLayouts, VkPushConstantRange* pushConstant);
+VulkanPipelineDesc defaultPipelineDesc(void);
+VulkanPipeline acquirePipeline(VulkanContext* context, const VulkanPipelineDesc* desc);
+void releasePipeline(VulkanContext* context, VulkanPipeline* pipeline, uint64_t retireValue);
+void destroyPipelineRegistry(VulkanContext* context);
 void destroyPipeline(VulkanContext* context, VulkanPipeline* pipeline);
+VulkanDrawDataLayout selectDrawDataLayout(VulkanContext* context, uint32_t size, VkShaderStageFlags stages, uint32_t set, bool allowPushConstants);
+bool cmdSetDrawData(VkCommandBuffer commandBuffer, const VulkanPipeline* pipeline, VulkanFrameAllocator* allocator,
+        VkDescriptorSet set, const void* data);
+
+// vulkan_sampler.c
+VkSampler getSampler(VulkanContext* context, const VulkanSamplerDesc* desc);
+void destroySamplerCache(VulkanContext* context);
+
+// vulkan_resources.c
+VulkanBufferHandle createPooledBuffer(VulkanContext* context, uint64_t size, VkBufferUsageFlags usage,
+        VkMemoryPropertyFlags memoryProperties, VulkanMemoryCategory category);
+VulkanBuffer* getBuffer(VulkanContext* context, VulkanBufferHandle handle);
+void releaseBuffer(VulkanContext* context, VulkanBufferHandle* handle);
+VulkanImageHandle createPooledImage(VulkanContext* context, uint32_t width, uint32_t height, VkFormat format,
+        VkImageUsageFlags usage, VkSampleCountFlagBits sampleCount, VulkanMemoryCategory category);
+VulkanImage* getImage(VulkanContext* context, VulkanImageHandle handle);
+void releaseImage(VulkanContext* context, VulkanImageHandle* handle);
+void destroyResourcePools(VulkanContext* context);
+
+// vulkan_sync.c
+bool createQueueTimeline(VulkanContext* context, VulkanQueue* queue);
+void destroyQueueTimeline(VulkanContext* context, VulkanQueue* queue);
+uint64_t getCompletedTimelineValue(VulkanContext* context, VulkanQueue* queue);
+bool waitForTimelineValue(VulkanContext* context, VulkanQueue* queue, uint64_t value, uint64_t timeout);
+uint64_t submitToQueue(VulkanContext* context, VulkanQueue* queue, VkCommandBuffer commandBuffer,
+        VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage, VkSemaphore signalSemaphore);
+
+// vulkan_deletion.c
+void deferDeletion(VulkanContext* context, VulkanDeletion deletion);
+// buffers and images retire at their lastUse, which the submissions using them have to keep up to date
+void deferDestroyBuffer(VulkanContext* context, VulkanBuffer* buffer);
+void deferDestroyImage(VulkanContext* context, VulkanImage* image);
+void deferDestroyFramebuffer(VulkanContext* context, VkFramebuffer framebuffer, uint64_t retireValue);
+void deferDestroyRenderPass(VulkanContext* context, VkRenderPass renderPass, uint64_t retireValue);
+void deferDestroySwapchain(VulkanContext* context, VulkanSwapchain* swapchain, uint64_t retireValue);
+void deferDestroyPipeline(VulkanContext* context, VulkanPipeline* pipeline, uint64_t retireValue);
+void deferDestroyPipelineLayout(VulkanContext* context, VkPipelineLayout layout, uint64_t retireValue);
+void deferDestroyDescriptorPool(VulkanContext* context, VkDescriptorPool descriptorPool, uint64_t retireValue);
+void flushDeletionQueue(VulkanContext* context);
+void destroyDeletionQueue(VulkanContext* context);
+
+// vulkan_readback.c
+// Copies images into host memory without stalling: nothing waits for the copy,
+// pollReadback hands out slots once the gpu is done with them.
+bool createReadbackRing(VulkanContext* context, VulkanReadbackRing* ring, uint32_t slotCount);
+void destroyReadbackRing(VulkanContext* context, VulkanReadbackRing* ring);
+VulkanReadbackSlot* cmdReadbackImage(VulkanContext* context, VulkanReadbackRing* ring, VkCommandBuffer commandBuffer,
+        VkImage image, VkImageLayout layout, VkFormat format, uint32_t width, uint32_t height, uint64_t tag);
+VulkanReadbackSlot* pollReadback(VulkanContext* context, VulkanReadbackRing* ring);
+void releaseReadback(VulkanReadbackSlot* slot);
+bool readbackToRgba8(const VulkanReadbackSlot* slot, uint8_t* pixels);
+
+// vulkan_frame_allocator.c
+bool createFrameAllocator(VulkanContext* context, VulkanFrameAllocator* allocator, VkDeviceSize frameSize, uint32_t frameCount);
+void destroyFrameAllocator(VulkanContext* context, VulkanFrameAllocator* allocator);
+void beginFrameAllocator(VulkanFrameAllocator* allocator, uint32_t frameIndex);
+void* frameAllocate(VulkanFrameAllocator* allocator, VkDeviceSize size, uint32_t* offset);
+
+// vulkan_descriptors.c
+void destroyDescriptorAllocator(VulkanContext* context, VulkanDescriptorAllocator* allocator);
+void resetDescriptorAllocator(VulkanContext* context, VulkanDescriptorAllocator* allocator);
+VkDescriptorSet allocateDescriptorSet(VulkanContext* context, VulkanDescriptorAllocator* allocator, VkDescriptorSetLayout layout);
+VkDescriptorSetLayout getDescriptorSetLayout(VulkanContext* context, const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingCount);
+VkDescriptorUpdateTemplate getDescriptorUpdateTemplate(VulkanContext* context, VkDescriptorSetLayout layout);
+void destroyDescriptorLayoutCache(VulkanContext* context);
+
+// vulkan_bindless.c
+bool createBindless(VulkanContext* context, VulkanBindless* bindless, uint32_t textureCapacity, uint32_t materialCapacity);
+void destroyBindless(VulkanContext* context, VulkanBindless* bindless);
+uint32_t bindlessAddTexture(VulkanContext* context, VulkanBindless* bindless, VkImageView view, VkSampler sampler);
+uint32_t bindlessAddMaterial(VulkanBindless* bindless, const VulkanMaterial* material);
+
+// vulkan_memory.c
+void initMemoryTracker(VulkanContext* context);
+void trackAllocation(VulkanContext* context, VulkanAllocationInfo* allocation);
+void untrackAllocation(VulkanContext* context, VulkanAllocationInfo* allocation);
+void getMemorySnapshot(VulkanContext* context, VulkanMemorySnapshot* snapshot);
+void printMemorySnapshot(VulkanContext* context, FILE* file);
+const char* memoryCategoryName(VulkanMemoryCategory category);
 
 // vulkan_utils.c 
 void createBuffer(VulkanContext* context, VulkanBuffer* buffer, uint64_t size,
-        VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryProperties);
+        VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryProperties, VulkanMemoryCategory category);
 void destroyBuffer(VulkanContext* context, VulkanBuffer* buffer);
 uint32_t findMemoryType(VulkanContext* context, uint32_t typeFilter, VkMemoryPropertyFlags memoryProperties);
+bool hasMemoryType(VulkanContext* context, uint32_t typeFilter, VkMemoryPropertyFlags memoryProperties);
+VkImageAspectFlags getImageAspect(VkFormat format);
 void uploadDataToBuffer(VulkanContext* context, VulkanBuffer* buffer, void* data, size_t size);
 void createImage(VulkanContext* context, VulkanImage* image, uint32_t width, uint32_t height,
-                 VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits sampleCount);
+                 VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits sampleCount,
+                 VulkanMemoryCategory category);
 void destroyImage(VulkanContext* context, VulkanImage* image);
+void cmdTransitionImage(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect,
+                        VkImageLayout oldLayout, VkImageLayout newLayout,
+                        VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                        VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
 void uploadDataToImage(VulkanContext* context, VulkanImage* image, void* data,
                        uint32_t size, uint32_t width, uint32_t height,
                        VkImageLayout finalLayout, VkAccessFlags dstAccessMask);
+uint64_t hashBytes(uint64_t hash, const void* data, size_t size);
 
 #endif // VULKAN_BASE_H
       
@@ -0,0 +1,27 @@
+#!/bin/bash
+# Size and instruction count of every given SPIR-V module, one line per shader.
+# make writes it to shaders/report.txt, compare it before and after a shader change to see its cost.
+
+SPIRV_DIS=${SPIRV_DIS:-spirv-dis}
+
+printf "%-32s %8s %8s\n" "shader" "bytes" "instrs"
+for spv in "$@"; do
+    bytes=$(wc -c < "$spv")
+    if command -v "$SPIRV_DIS" > /dev/null; then
+        # debug info (names, sources, line markers, DebugInfo ext instructions) and decorations
+        # depend on -g and do not cost anything at run time, only the other opcodes are counted
+        instructions=$("$SPIRV_DIS" --no-header --no-color "$spv" | awk '
+            {
+                op = ($2 == "=") ? $3 : $1
+                if (op !~ /^Op/) next
+                if (op ~ /^Op(Source|SourceContinued|SourceExtension|Name|MemberName|String|Line|NoLine|ModuleProcessed)$/) next
+                if (op ~ /^Op(Decorate|MemberDecorate|DecorateString|MemberDecorateString|DecorateId|DecorationGroup|GroupDecorate|GroupMemberDecorate)$/) next
+                if (op == "OpExtInst" && $0 ~ / Debug[A-Za-z]+/) next
+                count++
+            }
+            END { print count + 0 }')
+    else
+        instructions="-"
+    fi
+    printf "%-32s %8s %8s\n" "$(basename "$spv")" "$bytes" "$instructions"
+done
@@ -0,0 +1,9 @@
+#version 450 core
+
+layout (location = 0) out vec2 out_uv;
+
+// One triangle covering the screen, no vertex buffer: (0,0) (2,0) (0,2) in uv
+void main() {
+    out_uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(out_uv * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,61 @@
+#version 450 core
+
+layout (location = 0) in vec2 in_uv;
+
+layout (location = 0) out vec4 out_color;
+
+layout (set = 0, binding = 0) uniform sampler2D in_sceneColor;
+
+layout (push_constant) uniform PostParams {
+    vec2 uvScale;
+    vec2 texelSize;
+    float sharpness;
+} u_params;
+
+// FXAA (console variant): blur along the edge direction estimated from the luma of the
+// four diagonal neighbours, and fall back to a narrower blur if the wide one overshoots
+#define FXAA_SPAN_MAX 8.0
+#define FXAA_REDUCE_MUL (1.0 / 8.0)
+#define FXAA_REDUCE_MIN (1.0 / 128.0)
+
+float luma(vec3 color) {
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+void main() {
+    vec2 texel = u_params.texelSize;
+    // only the top left uvScale part was rendered, keep the bilinear taps inside of it
+    vec2 uvMax = u_params.uvScale - 0.5 * texel;
+    vec2 uv = min(in_uv * u_params.uvScale, uvMax);
+
+    vec3 rgbNW = texture(in_sceneColor, uv + vec2(-1.0, -1.0) * texel).rgb;
+    vec3 rgbNE = texture(in_sceneColor, uv + vec2( 1.0, -1.0) * texel).rgb;
+    vec3 rgbSW = texture(in_sceneColor, uv + vec2(-1.0,  1.0) * texel).rgb;
+    vec3 rgbSE = texture(in_sceneColor, uv + vec2( 1.0,  1.0) * texel).rgb;
+    vec4 center = texture(in_sceneColor, uv);
+
+    float lumaNW = luma(rgbNW);
+    float lumaNE = luma(rgbNE);
+    float lumaSW = luma(rgbSW);
+    float lumaSE = luma(rgbSE);
+    float lumaM = luma(center.rgb);
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    vec2 dir;
+    dir.x = -((lumaNW + lumaNE) - (lumaSW + lumaSE));
+    dir.y = ((lumaNW + lumaSW) - (lumaNE + lumaSE));
+
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * (0.25 * FXAA_REDUCE_MUL), FXAA_REDUCE_MIN);
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, vec2(-FXAA_SPAN_MAX), vec2(FXAA_SPAN_MAX)) * texel;
+
+    vec3 rgbA = 0.5 * (texture(in_sceneColor, uv + dir * (1.0 / 3.0 - 0.5)).rgb +
+                       texture(in_sceneColor, uv + dir * (2.0 / 3.0 - 0.5)).rgb);
+    vec3 rgbB = rgbA * 0.5 + 0.25 * (texture(in_sceneColor, uv - dir * 0.5).rgb +
+                                     texture(in_sceneColor, uv + dir * 0.5).rgb);
+
+    float lumaB = luma(rgbB);
+    out_color = vec4((lumaB < lumaMin || lumaB > lumaMax) ? rgbA : rgbB, center.a);
+}
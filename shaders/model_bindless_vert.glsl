@@ -0,0 +1,32 @@
+#version 450 core
+
+layout (location = 0) in vec3 in_pos;
+layout (location = 1) in vec3 in_normal;
+layout (location = 2) in vec2 in_texcoord;
+
+// per draw data, see VulkanDrawDataLayout
+#ifdef DRAW_DATA_PUSH_CONSTANTS
+layout (push_constant) uniform transforms {
+#else
+layout (set = 1, binding = 0) uniform transforms {
+#endif
+    mat4 modelViewProj;
+    mat4 modelView;
+    mat3 normalMatrix; // inverse transpose of modelView, computed on the cpu
+} u_transforms;
+
+layout (location = 0) out vec3 out_normal;
+layout (location = 1) out vec2 out_texcoord;
+layout (location = 2) out vec3 out_position;
+layout (location = 3) flat out uint out_material;
+
+void main() {
+    mat4 modelViewProj = u_transforms.modelViewProj;
+    gl_Position = modelViewProj * vec4(in_pos.x, in_pos.y, in_pos.z, 1.0);
+    out_normal = u_transforms.normalMatrix * in_normal;
+    out_texcoord = in_texcoord;
+    out_position = (u_transforms.modelView * vec4(in_pos, 1.0)).xyz;
+
+    // draws pass the material index as firstInstance, so merged indirect draws keep theirs
+    out_material = gl_InstanceIndex;
+}
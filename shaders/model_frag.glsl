@@ -10,24 +10,43 @@ layout (set = 0, binding = 1) uniform sampler2D in_albedoSampledTexture;
 
 layout (location = 0) out vec4 out_color;
 
+// set per pipeline from ShadingVariant (main.c), the branches not taken are compiled out
+layout (constant_id = 0) const uint SHADING_MODE = 0; // 0 lit, 1 normals, 2 unlit
+layout (constant_id = 1) const bool SPECULAR = true;
+layout (constant_id = 2) const float SHININESS = 16.0;
+layout (constant_id = 3) const float AMBIENT = 0.2;
+layout (constant_id = 4) const float SPECULAR_WEIGHT = 0.4;
+layout (constant_id = 5) const float LIGHT_X = 1.0;
+layout (constant_id = 6) const float LIGHT_Y = 1.0;
+layout (constant_id = 7) const float LIGHT_Z = -1.0;
+
 void main() {
     vec3 view = normalize(-in_position);
     vec4 texSample = texture(in_albedoSampledTexture, in_texcoord);
 
     vec3 normal = normalize(in_normal);
-    
-    vec3 light = normalize(vec3(1, 1, -1));
-    vec3 reflection = reflect(-light, normal);
-    float shininess = 16.0f;
+
+    if (SHADING_MODE == 1) {
+        out_color = vec4(normal * 0.5 + 0.5, 1.0);
+        return;
+    }
+    if (SHADING_MODE == 2) {
+        out_color = texSample;
+        return;
+    }
+
+    vec3 light = normalize(vec3(LIGHT_X, LIGHT_Y, LIGHT_Z));
 
     vec3 diffuse = max(dot(normal, light), 0.0) * texSample.rgb;
-    vec3 specular = pow(max(dot(view, reflection), 0.0), shininess) * vec3(1.0);
-    vec3 ambient = 0.2f * texSample.rgb;
+    vec3 ambient = AMBIENT * texSample.rgb;
+    vec3 combined = diffuse + ambient;
 
-    vec3 combined = 1.0 * diffuse + ambient + 0.4 * specular;
+    if (SPECULAR) {
+        vec3 reflection = reflect(-light, normal);
+        vec3 specular = pow(max(dot(view, reflection), 0.0), SHININESS) * vec3(1.0);
+        combined += SPECULAR_WEIGHT * specular;
+    }
 
-    //out_color = vec4(normal * 0.5 + 0.5, 1.0);
-    //out_color = texSample;
     out_color = vec4(combined, texSample.a);
 }
 
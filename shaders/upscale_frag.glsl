@@ -0,0 +1,39 @@
+#version 450 core
+
+layout (location = 0) in vec2 in_uv;
+
+layout (location = 0) out vec4 out_color;
+
+layout (set = 0, binding = 0) uniform sampler2D in_sceneColor;
+
+layout (push_constant) uniform PostParams {
+    vec2 uvScale;
+    vec2 texelSize;
+    float sharpness;
+} u_params;
+
+// Bilinear upscale followed by contrast adaptive sharpening: the negative lobe of the
+// sharpening kernel is scaled down where the neighbourhood is already close to 0 or 1,
+// so edges get crisper without ringing.
+void main() {
+    vec2 texel = u_params.texelSize;
+    // only the top left uvScale part was rendered, keep the bilinear taps inside of it
+    vec2 uvMax = u_params.uvScale - 0.5 * texel;
+    vec2 uv = min(in_uv * u_params.uvScale, uvMax);
+
+    vec4 center = texture(in_sceneColor, uv);
+    vec3 c = center.rgb;
+    vec3 n = texture(in_sceneColor, min(uv + vec2( 0.0, -1.0) * texel, uvMax)).rgb;
+    vec3 s = texture(in_sceneColor, min(uv + vec2( 0.0,  1.0) * texel, uvMax)).rgb;
+    vec3 w = texture(in_sceneColor, min(uv + vec2(-1.0,  0.0) * texel, uvMax)).rgb;
+    vec3 e = texture(in_sceneColor, min(uv + vec2( 1.0,  0.0) * texel, uvMax)).rgb;
+
+    vec3 minColor = min(c, min(min(n, s), min(w, e)));
+    vec3 maxColor = max(c, max(max(n, s), max(w, e)));
+
+    vec3 amplitude = sqrt(clamp(min(minColor, 1.0 - maxColor) / max(maxColor, vec3(1e-5)), 0.0, 1.0));
+    vec3 weight = amplitude * (-1.0 / mix(8.0, 5.0, u_params.sharpness));
+
+    vec3 result = (c + (n + s + w + e) * weight) / (1.0 + 4.0 * weight);
+    out_color = vec4(clamp(result, 0.0, 1.0), center.a);
+}
@@ -0,0 +1,190 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/bench.h"
+#include "../include/cpu_profiler.h"
+#include "../include/trace.h"
+#include "../include/stats.h"
+
+bool benchBegin(Benchmark* bench) {
+    bench->capacity = bench->frameCount ? bench->frameCount : 1024;
+    bench->frames = malloc(sizeof(BenchFrame) * bench->capacity);
+    if (!bench->frames) {
+        fprintf(stderr, "Failed to allocate benchmark frames!\n");
+        return false;
+    }
+
+    bench->frame = 0;
+    bench->recordedCount = 0;
+    bench->startNs = 0;
+    bench->lastFrameNs = traceNowNs();
+    return true;
+}
+
+double benchSceneTime(const Benchmark* bench) {
+    return (double)bench->frame * BENCH_TIME_STEP;
+}
+
+// One closed loop every 12 seconds around the model: the distance and height change
+// over the loop so the model covers a different part of the screen from frame to frame.
+void benchCameraPath(double time, HMM_Vec3* position, HMM_Vec3* target) {
+    const double loopSeconds = 12.0;
+    double angle = time / loopSeconds * 2.0 * HMM_PI;
+
+    float radius = 2.5f + 1.0f * (float)sin(angle * 2.0);
+    float height = 0.8f * (float)sin(angle * 3.0);
+
+    *target = HMM_V3(0.0f, 0.0f, 3.0f);
+    *position = HMM_V3(target->X + radius * (float)sin(angle), height, target->Z - radius * (float)cos(angle));
+}
+
+void benchRecordGpuTime(Benchmark* bench, uint64_t frame, double gpuMs) {
+    if (frame < bench->warmupFrames) return;
+
+    uint64_t index = frame - bench->warmupFrames;
+    if (index < bench->recordedCount) {
+        bench->frames[index].gpuMs = gpuMs;
+    }
+}
+
+bool benchEndFrame(Benchmark* bench) {
+    uint64_t now = traceNowNs();
+    uint64_t frame = bench->frame++;
+
+    if (frame >= bench->warmupFrames) {
+        if (frame == bench->warmupFrames) {
+            bench->startNs = bench->lastFrameNs;
+        }
+
+        if (bench->recordedCount == bench->capacity) {
+            BenchFrame* frames = realloc(bench->frames, sizeof(BenchFrame) * bench->capacity * 2);
+            if (!frames) {
+                fprintf(stderr, "Failed to grow benchmark frames!\n");
+                return true;
+            }
+            bench->frames = frames;
+            bench->capacity *= 2;
+        }
+
+        BenchFrame* record = &bench->frames[bench->recordedCount++];
+        record->cpuMs = (double)(now - bench->lastFrameNs) * 1e-6;
+        record->gpuMs = -1.0;
+    }
+    bench->lastFrameNs = now;
+
+    if (bench->frameCount) {
+        return bench->recordedCount >= bench->frameCount;
+    }
+    return bench->startNs && (double)(now - bench->startNs) * 1e-9 >= bench->duration;
+}
+
+static void printStats(const char* name, const SampleStats* stats) {
+    printf("%-10s %8u %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f\n", name, stats->samples, stats->avgMs,
+           stats->minMs, stats->p50Ms, stats->p95Ms, stats->p99Ms, stats->maxMs);
+}
+
+static void writeJsonStats(FILE* file, const SampleStats* stats) {
+    fprintf(file, "{\"samples\": %u, \"avg\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+            stats->samples, stats->avgMs, stats->minMs, stats->p50Ms, stats->p95Ms, stats->p99Ms, stats->maxMs);
+}
+
+static void writeJson(Benchmark* bench, FILE* file, const SampleStats* cpu, const SampleStats* gpu, double seconds) {
+    fprintf(file, "{\n");
+    fprintf(file, "  \"device\": \"%s\",\n", bench->deviceName ? bench->deviceName : "");
+    fprintf(file, "  \"presentMode\": \"%s\",\n", bench->presentMode ? bench->presentMode : "");
+    fprintf(file, "  \"antiAliasing\": \"%s\",\n", bench->antiAliasing ? bench->antiAliasing : "");
+    fprintf(file, "  \"width\": %u,\n  \"height\": %u,\n", bench->width, bench->height);
+    fprintf(file, "  \"framesInFlight\": %u,\n", bench->framesInFlight);
+    fprintf(file, "  \"warmupFrames\": %u,\n", bench->warmupFrames);
+    fprintf(file, "  \"seconds\": %.4f,\n", seconds);
+
+    fprintf(file, "  \"cpu\": ");
+    writeJsonStats(file, cpu);
+    fprintf(file, ",\n  \"gpu\": ");
+    writeJsonStats(file, gpu);
+
+    CpuPhaseStats phases[CPU_PROFILER_MAX_PHASES];
+    uint32_t phaseCount = cpuProfilerGetStats(phases, CPU_PROFILER_MAX_PHASES);
+    fprintf(file, ",\n  \"cpuPhases\": [");
+    for (uint32_t i = 0; i < phaseCount; i++) {
+        fprintf(file, "%s\n    {\"name\": \"%s\", \"samples\": %u, \"avg\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+                i ? "," : "", phases[i].name, phases[i].samples, phases[i].avgMs,
+                phases[i].p50Ms, phases[i].p95Ms, phases[i].p99Ms, phases[i].maxMs);
+    }
+    fprintf(file, "\n  ],\n");
+
+    fprintf(file, "  \"frames\": [");
+    for (uint32_t i = 0; i < bench->recordedCount; i++) {
+        BenchFrame* frame = &bench->frames[i];
+        fprintf(file, "%s\n    {\"cpu\": %.4f, \"gpu\": ", i ? "," : "", frame->cpuMs);
+        if (frame->gpuMs >= 0.0) fprintf(file, "%.4f}", frame->gpuMs);
+        else fputs("null}", file);
+    }
+    fprintf(file, "\n  ]\n}\n");
+}
+
+static void writeCsv(Benchmark* bench, FILE* file) {
+    fprintf(file, "frame,cpu_ms,gpu_ms\n");
+    for (uint32_t i = 0; i < bench->recordedCount; i++) {
+        BenchFrame* frame = &bench->frames[i];
+        fprintf(file, "%u,%.4f,", i, frame->cpuMs);
+        if (frame->gpuMs >= 0.0) fprintf(file, "%.4f", frame->gpuMs);
+        fputc('\n', file);
+    }
+}
+
+void benchFinish(Benchmark* bench) {
+    double seconds = bench->startNs ? (double)(bench->lastFrameNs - bench->startNs) * 1e-9 : 0.0;
+
+    double* values = malloc(sizeof(double) * (bench->recordedCount ? bench->recordedCount : 1));
+    if (!values) {
+        fprintf(stderr, "Failed to allocate benchmark statistics!\n");
+        free(bench->frames);
+        bench->frames = NULL;
+        return;
+    }
+
+    for (uint32_t i = 0; i < bench->recordedCount; i++) {
+        values[i] = bench->frames[i].cpuMs;
+    }
+    SampleStats cpu = computeSampleStats(values, bench->recordedCount);
+
+    uint32_t gpuCount = 0;
+    for (uint32_t i = 0; i < bench->recordedCount; i++) {
+        if (bench->frames[i].gpuMs >= 0.0) values[gpuCount++] = bench->frames[i].gpuMs;
+    }
+    SampleStats gpu = computeSampleStats(values, gpuCount);
+    free(values);
+
+    printf("Benchmark: %u frames in %.2lf s on %s (%ux%u, %s, %s)\n", bench->recordedCount, seconds,
+           bench->deviceName ? bench->deviceName : "?", bench->width, bench->height,
+           bench->presentMode ? bench->presentMode : "?", bench->antiAliasing ? bench->antiAliasing : "?");
+    printf("%-10s %8s %8s %8s %8s %8s %8s %8s\n", "time (ms)", "samples", "avg", "min", "p50", "p95", "p99", "max");
+    printStats("cpu frame", &cpu);
+    printStats("gpu frame", &gpu);
+    cpuProfilerPrintStats(stdout);
+
+    if (bench->outputPath) {
+        FILE* file = fopen(bench->outputPath, "w");
+        if (!file) {
+            fprintf(stderr, "Failed to open benchmark output: %s!\n", bench->outputPath);
+        }
+        else {
+            size_t length = strlen(bench->outputPath);
+            if (length >= 5 && strcmp(bench->outputPath + length - 5, ".json") == 0) {
+                writeJson(bench, file, &cpu, &gpu, seconds);
+            }
+            else {
+                writeCsv(bench, file);
+            }
+            fclose(file);
+            printf("Benchmark results written to %s\n", bench->outputPath);
+        }
+    }
+
+    free(bench->frames);
+    bench->frames = NULL;
+}
@@ -0,0 +1,298 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "../include/cpu_profiler.h"
+#include "../include/stats.h"
+
+typedef struct {
+    const char* name;
+    uint64_t startNs;
+    uint64_t endNs;
+} CpuProfilerEvent;
+
+// Single producer (the owning thread), single consumer (cpuProfilerEndFrame)
+typedef struct {
+    CpuProfilerEvent events[CPU_PROFILER_RING_SIZE];
+    _Atomic uint64_t head; // next event the owner writes
+    uint64_t tail;         // next event the consumer reads
+
+    uint32_t id;
+    const char* name;
+    bool nameWritten; // thread name metadata is in the trace
+
+    // open scopes, only touched by the owning thread
+    const char* openNames[CPU_PROFILER_MAX_DEPTH];
+    uint64_t openStarts[CPU_PROFILER_MAX_DEPTH];
+    uint32_t openCount;
+} CpuProfilerThread;
+
+typedef struct {
+    const char* name;
+    double frameTotalMs;
+    bool seenThisFrame;
+
+    double* window; // ring of per frame totals
+    uint32_t windowCapacity;
+    uint32_t windowCount;
+    uint32_t windowNext;
+} CpuPhase;
+
+static struct {
+    _Atomic bool enabled;
+
+    pthread_mutex_t threadsLock;
+    CpuProfilerThread* threads[CPU_PROFILER_MAX_THREADS];
+    uint32_t threadCount;
+
+    CpuPhase phases[CPU_PROFILER_MAX_PHASES];
+    uint32_t phaseCount;
+    uint32_t windowFrames; // 0 = every frame since the last reset, the windows grow
+    double* sortScratch;
+    uint32_t scratchCapacity;
+
+    uint64_t lastFrameEndNs;
+    uint64_t droppedEvents;
+} profiler = { .threadsLock = PTHREAD_MUTEX_INITIALIZER };
+
+static _Thread_local CpuProfilerThread* localThread;
+
+void cpuProfilerInit(uint32_t windowFrames) {
+    profiler.windowFrames = windowFrames;
+    profiler.lastFrameEndNs = traceNowNs();
+    atomic_store(&profiler.enabled, true);
+}
+
+void cpuProfilerShutdown(void) {
+    atomic_store(&profiler.enabled, false);
+
+    pthread_mutex_lock(&profiler.threadsLock);
+    for (uint32_t i = 0; i < profiler.threadCount; i++) {
+        free(profiler.threads[i]);
+    }
+    profiler.threadCount = 0;
+    pthread_mutex_unlock(&profiler.threadsLock);
+
+    for (uint32_t i = 0; i < profiler.phaseCount; i++) {
+        free(profiler.phases[i].window);
+    }
+    profiler.phaseCount = 0;
+    free(profiler.sortScratch);
+    profiler.sortScratch = NULL;
+    profiler.scratchCapacity = 0;
+    localThread = NULL;
+}
+
+static CpuProfilerThread* getThread(void) {
+    if (localThread) return localThread;
+
+    CpuProfilerThread* thread = calloc(1, sizeof(CpuProfilerThread));
+    if (!thread) return NULL;
+
+    pthread_mutex_lock(&profiler.threadsLock);
+    if (profiler.threadCount == CPU_PROFILER_MAX_THREADS) {
+        pthread_mutex_unlock(&profiler.threadsLock);
+        free(thread);
+        return NULL;
+    }
+    thread->id = profiler.threadCount + 1;
+    profiler.threads[profiler.threadCount++] = thread;
+    pthread_mutex_unlock(&profiler.threadsLock);
+
+    localThread = thread;
+    return thread;
+}
+
+void cpuProfilerSetThreadName(const char* name) {
+    if (!atomic_load_explicit(&profiler.enabled, memory_order_relaxed)) return;
+
+    CpuProfilerThread* thread = getThread();
+    if (thread) thread->name = name;
+}
+
+void cpuProfilerBeginScope(const char* name) {
+    if (!atomic_load_explicit(&profiler.enabled, memory_order_relaxed)) return;
+
+    CpuProfilerThread* thread = getThread();
+    if (!thread) return;
+
+    // deeper scopes are still counted so the matching end pops the right one
+    if (thread->openCount < CPU_PROFILER_MAX_DEPTH) {
+        thread->openNames[thread->openCount] = name;
+        thread->openStarts[thread->openCount] = traceNowNs();
+    }
+    thread->openCount++;
+}
+
+void cpuProfilerEndScope(void) {
+    if (!atomic_load_explicit(&profiler.enabled, memory_order_relaxed)) return;
+
+    CpuProfilerThread* thread = localThread;
+    if (!thread || thread->openCount == 0) return;
+
+    uint32_t depth = --thread->openCount;
+    if (depth >= CPU_PROFILER_MAX_DEPTH) return;
+
+    uint64_t head = atomic_load_explicit(&thread->head, memory_order_relaxed);
+    CpuProfilerEvent* event = &thread->events[head & (CPU_PROFILER_RING_SIZE - 1)];
+    event->name = thread->openNames[depth];
+    event->startNs = thread->openStarts[depth];
+    event->endNs = traceNowNs();
+    atomic_store_explicit(&thread->head, head + 1, memory_order_release);
+}
+
+static CpuPhase* getPhase(const char* name) {
+    for (uint32_t i = 0; i < profiler.phaseCount; i++) {
+        CpuPhase* phase = &profiler.phases[i];
+        if (phase->name == name || strcmp(phase->name, name) == 0) return phase;
+    }
+
+    if (profiler.phaseCount == CPU_PROFILER_MAX_PHASES) return NULL;
+
+    uint32_t capacity = profiler.windowFrames ? profiler.windowFrames : 1024;
+    double* window = calloc(capacity, sizeof(double));
+    if (!window) return NULL;
+
+    CpuPhase* phase = &profiler.phases[profiler.phaseCount++];
+    *phase = (CpuPhase){0};
+    phase->name = name;
+    phase->window = window;
+    phase->windowCapacity = capacity;
+    return phase;
+}
+
+static void addToPhase(const char* name, double durationMs) {
+    CpuPhase* phase = getPhase(name);
+    if (!phase) return;
+
+    phase->frameTotalMs += durationMs;
+    phase->seenThisFrame = true;
+}
+
+static void drainThread(CpuProfilerThread* thread, TraceWriter* trace) {
+    if (!thread->nameWritten && thread->name) {
+        traceWriteThreadName(trace, thread->id, thread->name);
+        thread->nameWritten = true;
+    }
+
+    uint64_t head = atomic_load_explicit(&thread->head, memory_order_acquire);
+    if (head - thread->tail > CPU_PROFILER_RING_SIZE) {
+        // the owner lapped us, the oldest events are gone
+        profiler.droppedEvents += head - thread->tail - CPU_PROFILER_RING_SIZE;
+        thread->tail = head - CPU_PROFILER_RING_SIZE;
+    }
+
+    for (uint64_t i = thread->tail; i < head; i++) {
+        CpuProfilerEvent event = thread->events[i & (CPU_PROFILER_RING_SIZE - 1)];
+
+        // The owner keeps recording while we read, the slot may have been reused meanwhile. Once head
+        // reached i + CPU_PROFILER_RING_SIZE the owner may be writing slot i, so the copy can be torn.
+        // The fence keeps the copy above from moving past the head load.
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t currentHead = atomic_load_explicit(&thread->head, memory_order_relaxed);
+        if (currentHead - i >= CPU_PROFILER_RING_SIZE) {
+            profiler.droppedEvents++;
+            continue;
+        }
+
+        addToPhase(event.name, (double)(event.endNs - event.startNs) * 1e-6);
+        traceWriteComplete(trace, event.name, "cpu", thread->id, event.startNs, event.endNs - event.startNs);
+    }
+    thread->tail = head;
+}
+
+void cpuProfilerEndFrame(TraceWriter* trace) {
+    if (!atomic_load_explicit(&profiler.enabled, memory_order_relaxed)) return;
+
+    pthread_mutex_lock(&profiler.threadsLock);
+    uint32_t threadCount = profiler.threadCount;
+    pthread_mutex_unlock(&profiler.threadsLock);
+
+    // threads are only appended, the first threadCount entries stay valid
+    for (uint32_t i = 0; i < threadCount; i++) {
+        drainThread(profiler.threads[i], trace);
+    }
+
+    uint64_t now = traceNowNs();
+    addToPhase("frame", (double)(now - profiler.lastFrameEndNs) * 1e-6);
+    profiler.lastFrameEndNs = now;
+
+    for (uint32_t i = 0; i < profiler.phaseCount; i++) {
+        CpuPhase* phase = &profiler.phases[i];
+        if (!phase->seenThisFrame) continue;
+
+        // without a fixed window every frame is kept, if growing fails the oldest frames are overwritten
+        if (!profiler.windowFrames && phase->windowCount == phase->windowCapacity) {
+            double* window = realloc(phase->window, sizeof(double) * phase->windowCapacity * 2);
+            if (window) {
+                phase->window = window;
+                phase->windowNext = phase->windowCapacity;
+                phase->windowCapacity *= 2;
+            }
+        }
+
+        phase->window[phase->windowNext] = phase->frameTotalMs;
+        phase->windowNext = (phase->windowNext + 1) % phase->windowCapacity;
+        if (phase->windowCount < phase->windowCapacity) phase->windowCount++;
+
+        phase->frameTotalMs = 0.0;
+        phase->seenThisFrame = false;
+    }
+}
+
+void cpuProfilerResetStats(void) {
+    for (uint32_t i = 0; i < profiler.phaseCount; i++) {
+        profiler.phases[i].windowCount = 0;
+        profiler.phases[i].windowNext = 0;
+    }
+}
+
+uint32_t cpuProfilerGetStats(CpuPhaseStats* stats, uint32_t maxStats) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < profiler.phaseCount && count < maxStats; i++) {
+        CpuPhase* phase = &profiler.phases[i];
+        if (phase->windowCount == 0) continue;
+
+        if (phase->windowCount > profiler.scratchCapacity) {
+            double* scratch = realloc(profiler.sortScratch, sizeof(double) * phase->windowCount);
+            if (!scratch) {
+                fprintf(stderr, "Failed to allocate cpu profiler statistics!\n");
+                continue;
+            }
+            profiler.sortScratch = scratch;
+            profiler.scratchCapacity = phase->windowCount;
+        }
+
+        memcpy(profiler.sortScratch, phase->window, sizeof(double) * phase->windowCount);
+        SampleStats sampleStats = computeSampleStats(profiler.sortScratch, phase->windowCount);
+
+        CpuPhaseStats* phaseStats = &stats[count++];
+        phaseStats->name = phase->name;
+        phaseStats->samples = sampleStats.samples;
+        phaseStats->avgMs = sampleStats.avgMs;
+        phaseStats->p50Ms = sampleStats.p50Ms;
+        phaseStats->p95Ms = sampleStats.p95Ms;
+        phaseStats->p99Ms = sampleStats.p99Ms;
+        phaseStats->maxMs = sampleStats.maxMs;
+    }
+    return count;
+}
+
+void cpuProfilerPrintStats(FILE* file) {
+    if (!atomic_load_explicit(&profiler.enabled, memory_order_relaxed)) return;
+
+    CpuPhaseStats stats[CPU_PROFILER_MAX_PHASES];
+    uint32_t count = cpuProfilerGetStats(stats, CPU_PROFILER_MAX_PHASES);
+
+    fprintf(file, "%-12s %8s %8s %8s %8s %8s %8s\n", "phase (ms)", "samples", "avg", "p50", "p95", "p99", "max");
+    for (uint32_t i = 0; i < count; i++) {
+        fprintf(file, "%-12s %8u %8.3f %8.3f %8.3f %8.3f %8.3f\n", stats[i].name, stats[i].samples,
+                stats[i].avgMs, stats[i].p50Ms, stats[i].p95Ms, stats[i].p99Ms, stats[i].maxMs);
+    }
+    if (profiler.droppedEvents) {
+        fprintf(file, "dropped events: %lu\n", profiler.droppedEvents);
+    }
+}
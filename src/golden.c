@@ -0,0 +1,75 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../vendor/stb/stb_image.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../vendor/stb/stb_image_write.h"
+
+#include "../include/golden.h"
+
+bool writePng(const char* path, const uint8_t* rgba, uint32_t width, uint32_t height) {
+    if (!stbi_write_png(path, (int)width, (int)height, 4, rgba, (int)width * 4)) {
+        fprintf(stderr, "Failed to write image: %s!\n", path);
+        return false;
+    }
+    return true;
+}
+
+GoldenResult compareWithGolden(const char* goldenPath, const uint8_t* rgba, uint32_t width, uint32_t height,
+                               uint32_t tolerance, const char* diffPath) {
+    GoldenResult result = {0};
+
+    int goldenWidth, goldenHeight, channels;
+    uint8_t* golden = stbi_load(goldenPath, &goldenWidth, &goldenHeight, &channels, 4);
+    if (!golden) {
+        fprintf(stderr, "Failed to load golden image: %s!\n", goldenPath);
+        return result;
+    }
+    if ((uint32_t)goldenWidth != width || (uint32_t)goldenHeight != height) {
+        fprintf(stderr, "Golden image %s is %dx%d, the frame is %ux%u!\n", goldenPath, goldenWidth, goldenHeight, width, height);
+        stbi_image_free(golden);
+        return result;
+    }
+
+    uint8_t* diff = NULL;
+    if (diffPath) {
+        diff = malloc((size_t)width * height * 4);
+        if (!diff) {
+            fprintf(stderr, "Failed to allocate diff image!\n");
+        }
+    }
+
+    uint64_t differenceSum = 0;
+    result.totalPixels = width * height;
+
+    for (uint32_t i = 0; i < result.totalPixels; i++) {
+        uint32_t pixelDifference = 0;
+        for (uint32_t c = 0; c < 3; c++) {
+            int difference = abs((int)rgba[i * 4 + c] - (int)golden[i * 4 + c]);
+            differenceSum += difference;
+            if ((uint32_t)difference > pixelDifference) pixelDifference = difference;
+        }
+
+        if (pixelDifference > result.maxDifference) result.maxDifference = pixelDifference;
+        bool mismatch = pixelDifference > tolerance;
+        if (mismatch) result.mismatchedPixels++;
+
+        if (diff) {
+            for (uint32_t c = 0; c < 3; c++) diff[i * 4 + c] = rgba[i * 4 + c] / 4;
+            if (mismatch) diff[i * 4 + 0] = 255;
+            diff[i * 4 + 3] = 255;
+        }
+    }
+
+    result.meanDifference = (double)differenceSum / ((double)result.totalPixels * 3.0);
+    result.compared = true;
+
+    if (diff) {
+        writePng(diffPath, diff, width, height);
+        free(diff);
+    }
+    stbi_image_free(golden);
+    return result;
+}
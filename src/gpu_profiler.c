@@ -0,0 +1,269 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vulkan/vulkan_core.h>
+
+#include "../include/gpu_profiler.h"
+
+static bool createQueryPool(GpuProfiler* profiler, GpuProfilerFrame* frame, uint32_t capacity) {
+    VkQueryPoolCreateInfo createInfo = {0};
+    createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    createInfo.queryCount = capacity;
+
+    if (vkCreateQueryPool(profiler->context->device, &createInfo, NULL, &frame->queryPool) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create query pools!\n");
+        return false;
+    }
+
+    frame->queryResults = realloc(frame->queryResults, sizeof(uint64_t) * 2 * capacity);
+    if (!frame->queryResults) {
+        fprintf(stderr, "Failed to allocate query results!\n");
+        return false;
+    }
+
+    frame->queryCapacity = capacity;
+    return true;
+}
+
+void createGpuProfiler(VulkanContext* context, GpuProfiler* profiler, uint32_t frameCount) {
+    *profiler = (GpuProfiler){0};
+    profiler->context = context;
+    profiler->timestampPeriod = context->physicalDeviceProperties.limits.timestampPeriod;
+
+    uint32_t numQueueFamilies = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(context->physicalDevice, &numQueueFamilies, NULL);
+    VkQueueFamilyProperties* queueFamilies = malloc(sizeof(VkQueueFamilyProperties) * numQueueFamilies);
+    if (!queueFamilies) {
+        fprintf(stderr, "Failed to allocate queue family properties!\n");
+        return;
+    }
+    vkGetPhysicalDeviceQueueFamilyProperties(context->physicalDevice, &numQueueFamilies, queueFamilies);
+    uint32_t validBits = queueFamilies[context->graphicsQueue.familyIndex].timestampValidBits;
+    free(queueFamilies);
+
+    if (validBits == 0) {
+        fprintf(stderr, "Graphics queue does not support timestamps, gpu profiling disabled!\n");
+        return;
+    }
+    profiler->timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+
+    profiler->frames = calloc(frameCount, sizeof(GpuProfilerFrame));
+    if (!profiler->frames) {
+        fprintf(stderr, "Failed to allocate gpu profiler frames!\n");
+        return;
+    }
+    profiler->frameCount = frameCount;
+
+    for (uint32_t i = 0; i < frameCount; i++) {
+        if (!createQueryPool(profiler, &profiler->frames[i], GPU_PROFILER_INITIAL_QUERIES)) {
+            return;
+        }
+    }
+
+    profiler->enabled = true;
+}
+
+void destroyGpuProfiler(GpuProfiler* profiler) {
+    for (uint32_t i = 0; i < profiler->frameCount; i++) {
+        GpuProfilerFrame* frame = &profiler->frames[i];
+        vkDestroyQueryPool(profiler->context->device, frame->queryPool, NULL);
+        free(frame->queryResults);
+        free(frame->scopes);
+    }
+    free(profiler->frames);
+    free(profiler->results);
+    *profiler = (GpuProfiler){0};
+}
+
+// Re-reads the gpu/cpu clock pair every frame so drift between the clocks stays small
+static void calibrate(GpuProfiler* profiler) {
+    VulkanContext* context = profiler->context;
+    if (!context->getCalibratedTimestamps) return;
+
+    VkCalibratedTimestampInfoEXT timestampInfos[2] = {0};
+    timestampInfos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+    timestampInfos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+    timestampInfos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+    timestampInfos[1].timeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+
+    uint64_t timestamps[2];
+    uint64_t maxDeviation;
+    if (context->getCalibratedTimestamps(context->device, 2, timestampInfos, timestamps, &maxDeviation) != VK_SUCCESS) {
+        return;
+    }
+
+    profiler->calibrationGpuTicks = timestamps[0] & profiler->timestampMask;
+    profiler->calibrationHostNs = timestamps[1];
+    profiler->calibrated = true;
+}
+
+void gpuProfilerBeginFrame(GpuProfiler* profiler, uint32_t frameIndex, VkCommandBuffer commandBuffer) {
+    if (!profiler->enabled) return;
+
+    GpuProfilerFrame* frame = &profiler->frames[frameIndex];
+    profiler->currentFrame = frameIndex;
+
+    if (frame->pending) {
+        // results were never collected, the queries are reset below
+        profiler->droppedFrames++;
+        frame->pending = false;
+    }
+
+    // the pool is idle, the slot's previous submission finished
+    if (frame->overflowed) {
+        uint32_t capacity = frame->queryCapacity * 2;
+        vkDestroyQueryPool(profiler->context->device, frame->queryPool, NULL);
+        if (!createQueryPool(profiler, frame, capacity)) {
+            profiler->enabled = false;
+            return;
+        }
+    }
+
+    vkCmdResetQueryPool(commandBuffer, frame->queryPool, 0, frame->queryCapacity);
+    frame->queryCount = 0;
+    frame->overflowed = false;
+    frame->scopeCount = 0;
+    frame->openCount = 0;
+
+    calibrate(profiler);
+}
+
+static uint32_t allocateQuery(GpuProfilerFrame* frame) {
+    if (frame->queryCount == frame->queryCapacity) {
+        frame->overflowed = true;
+        return UINT32_MAX;
+    }
+    return frame->queryCount++;
+}
+
+void gpuProfilerBeginScope(GpuProfiler* profiler, VkCommandBuffer commandBuffer, const char* name) {
+    if (!profiler->enabled) return;
+
+    GpuProfilerFrame* frame = &profiler->frames[profiler->currentFrame];
+    if (frame->openCount == GPU_PROFILER_MAX_DEPTH) {
+        fprintf(stderr, "Gpu profiler scopes nested too deep: %s!\n", name);
+        return;
+    }
+
+    if (frame->scopeCount == frame->scopeCapacity) {
+        uint32_t capacity = frame->scopeCapacity ? frame->scopeCapacity * 2 : 32;
+        GpuProfilerScope* scopes = realloc(frame->scopes, sizeof(GpuProfilerScope) * capacity);
+        if (!scopes) {
+            fprintf(stderr, "Failed to grow gpu profiler scopes!\n");
+            return;
+        }
+        frame->scopes = scopes;
+        frame->scopeCapacity = capacity;
+    }
+
+    uint32_t scopeIndex = frame->scopeCount++;
+    GpuProfilerScope* scope = &frame->scopes[scopeIndex];
+    scope->name = name;
+    scope->depth = frame->openCount;
+    scope->beginQuery = allocateQuery(frame);
+    scope->endQuery = UINT32_MAX;
+    frame->openScopes[frame->openCount++] = scopeIndex;
+
+    if (scope->beginQuery != UINT32_MAX) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame->queryPool, scope->beginQuery);
+    }
+}
+
+void gpuProfilerEndScope(GpuProfiler* profiler, VkCommandBuffer commandBuffer) {
+    if (!profiler->enabled) return;
+
+    GpuProfilerFrame* frame = &profiler->frames[profiler->currentFrame];
+    if (frame->openCount == 0) {
+        fprintf(stderr, "Gpu profiler scope ended without being begun!\n");
+        return;
+    }
+
+    GpuProfilerScope* scope = &frame->scopes[frame->openScopes[--frame->openCount]];
+    if (scope->beginQuery == UINT32_MAX) return;
+
+    scope->endQuery = allocateQuery(frame);
+    if (scope->endQuery != UINT32_MAX) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame->queryPool, scope->endQuery);
+    }
+}
+
+void gpuProfilerEndFrame(GpuProfiler* profiler) {
+    if (!profiler->enabled) return;
+
+    GpuProfilerFrame* frame = &profiler->frames[profiler->currentFrame];
+    if (frame->openCount != 0) {
+        fprintf(stderr, "Gpu profiler frame ended with %u open scopes!\n", frame->openCount);
+        frame->openCount = 0;
+    }
+
+    frame->pending = frame->queryCount > 0;
+    frame->submitTimeNs = traceNowNs();
+}
+
+// Without calibration the first timestamp of the frame is placed at its submit time,
+// which is good enough to line up with the cpu side but not exact.
+static uint64_t gpuTicksToHostNs(GpuProfiler* profiler, GpuProfilerFrame* frame, uint64_t ticks, uint64_t firstTicks) {
+    if (profiler->calibrated) {
+        int64_t deltaTicks = (int64_t)(ticks - profiler->calibrationGpuTicks);
+        return profiler->calibrationHostNs + (int64_t)((double)deltaTicks * profiler->timestampPeriod);
+    }
+    return frame->submitTimeNs + (uint64_t)((double)(ticks - firstTicks) * profiler->timestampPeriod);
+}
+
+bool gpuProfilerCollect(GpuProfiler* profiler, uint32_t frameIndex, TraceWriter* trace) {
+    if (!profiler->enabled) return false;
+
+    GpuProfilerFrame* frame = &profiler->frames[frameIndex];
+    if (!frame->pending) return false;
+
+    VkResult result = vkGetQueryPoolResults(profiler->context->device, frame->queryPool, 0, frame->queryCount,
+                                            sizeof(uint64_t) * 2 * frame->queryCount, frame->queryResults,
+                                            sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY) {
+        return false;
+    }
+    for (uint32_t i = 0; i < frame->queryCount; i++) {
+        if (frame->queryResults[i * 2 + 1] == 0) return false; // still in flight, try again later
+    }
+    frame->pending = false;
+
+    if (profiler->resultCapacity < frame->scopeCount) {
+        GpuProfilerResult* results = realloc(profiler->results, sizeof(GpuProfilerResult) * frame->scopeCount);
+        if (!results) {
+            fprintf(stderr, "Failed to grow gpu profiler results!\n");
+            return false;
+        }
+        profiler->results = results;
+        profiler->resultCapacity = frame->scopeCount;
+    }
+
+    // queries are allocated in recording order, the first one is the earliest
+    uint64_t firstTicks = frame->queryResults[0] & profiler->timestampMask;
+    uint64_t lastTicks = firstTicks;
+    double msPerTick = profiler->timestampPeriod * 1e-6;
+
+    profiler->resultCount = 0;
+    for (uint32_t i = 0; i < frame->scopeCount; i++) {
+        GpuProfilerScope* scope = &frame->scopes[i];
+        if (scope->beginQuery == UINT32_MAX || scope->endQuery == UINT32_MAX) continue;
+
+        uint64_t beginTicks = frame->queryResults[scope->beginQuery * 2] & profiler->timestampMask;
+        uint64_t endTicks = frame->queryResults[scope->endQuery * 2] & profiler->timestampMask;
+        if (endTicks < beginTicks) continue; // counter wrapped
+        if (endTicks > lastTicks) lastTicks = endTicks;
+
+        GpuProfilerResult* scopeResult = &profiler->results[profiler->resultCount++];
+        scopeResult->name = scope->name;
+        scopeResult->depth = scope->depth;
+        scopeResult->startMs = (double)(beginTicks - firstTicks) * msPerTick;
+        scopeResult->durationMs = (double)(endTicks - beginTicks) * msPerTick;
+
+        uint64_t startNs = gpuTicksToHostNs(profiler, frame, beginTicks, firstTicks);
+        uint64_t durationNs = (uint64_t)((double)(endTicks - beginTicks) * profiler->timestampPeriod);
+        traceWriteComplete(trace, scope->name, "gpu", TRACE_TID_GPU, startNs, durationNs);
+    }
+
+    profiler->frameTimeMs = (double)(lastTicks - firstTicks) * msPerTick;
+    return true;
+}
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <time.h>
 #include <string.h>
+#include <stddef.h>
 #include <vulkan/vulkan_core.h>
 
 #define GLFW_INCLUDE_VULKAN
@@ -16,14 +17,81 @@
 
 #include "../include/vulkan_base.h"
 #include "../include/model.h"
+#include "../include/gpu_profiler.h"
+#include "../include/cpu_profiler.h"
+#include "../include/trace.h"
+#include "../include/bench.h"
+#include "../include/golden.h"
+#include "../include/transform.h"
+#include "../include/scene.h"
 
-#define FRAMES_IN_FLIGHT 2
-
-#define USE_MODEL_PIPELINE
 //#define LOG_GPU_TIME
-//#define LOG_CPU_TIME
 
 void recreateRenderPass();
+void selectModelVariant();
+
+// CPU timestamps (glfwGetTime) of one frame, used to estimate input latency
+typedef struct {
+    double inputTime;
+    double submitTime;
+    double queueDelay; // time the submission waited for the previous frame on the gpu
+    uint64_t benchFrame; // Benchmark.frame of the recorded frame
+} FrameTiming;
+
+// MSAA with msaaSamples (1 disables anti aliasing), or FXAA: the scene is rendered single
+// sampled into sceneColorBuffers and filtered into the swapchain image by a fullscreen pass.
+typedef enum {
+    AA_MODE_MSAA,
+    AA_MODE_FXAA,
+} AntiAliasingMode;
+
+// push constants of the post processing pass
+typedef struct {
+    HMM_Vec2 uvScale;   // rendered part of the scene color buffer
+    HMM_Vec2 texelSize; // of the scene color buffer
+    float sharpness;
+} PostParams;
+
+// per draw data of the model shaders (push constants or a dynamic uniform buffer)
+typedef struct {
+    HMM_Mat4 modelViewProj;
+    HMM_Mat4 modelView;
+    NormalMatrix normalMatrix; // constant per draw, not worth an inverse per vertex
+} ModelTransforms;
+
+#define FRAME_ALLOCATOR_SIZE (256 * 1024) // per frame in flight
+
+// shaders and assets are loaded relative to this, the Makefile sets it to the repository
+#ifndef ASSET_DIR
+#define ASSET_DIR "."
+#endif
+
+typedef enum {
+    SHADING_LIT,
+    SHADING_NORMALS, // view space normals as colors
+    SHADING_UNLIT,   // albedo only
+    SHADING_MODE_COUNT,
+} ShadingMode;
+
+// Specialization constants of the model fragment shaders, field i is constant_id i.
+// Every field is 4 bytes so the struct is the specialization data as is.
+typedef struct {
+    uint32_t mode; // ShadingMode
+    VkBool32 specular;
+    float shininess;
+    float ambient;
+    float specularWeight;
+    float lightDirection[3];
+} ShadingVariant;
+
+// model pipelines already created for a shading variant, switching back to one is free
+#define MAX_MODEL_VARIANTS 8
+
+typedef struct {
+    uint64_t key; // hash of the variant
+    ShadingVariant variant;
+    VulkanPipeline pipeline;
+} ModelVariant;
 
 typedef struct {
     HMM_Vec3 cameraPosition;
@@ -44,39 +112,146 @@ VulkanContext* context;
 VkSurfaceKHR surface;
 VulkanSwapchain swapchain;
 VkRenderPass renderPass;
+VkRenderPass postRenderPass; // fullscreen pass into the swapchain image, only with post processing
+VkFormat renderPassFormat;
+
+// Render target settings the current attachments, render passes and pipelines were created with
+VkSampleCountFlagBits sampleCount;
+bool postProcessing = false; // scene is rendered into sceneColorBuffers (FXAA or dynamic resolution)
+bool fxaaEnabled = false;
 
+// Attachments are only needed while a frame renders, so there is one set per frame in flight.
+// Scene framebuffers: [frameIndex * imagesCount + imageIndex] when rendering into the swapchain,
+// [frameIndex] when rendering into sceneColorBuffers. Post framebuffers: [imageIndex]
 VkFramebuffer* framebuffers;
+VkFramebuffer* postFramebuffers;
 VulkanImage* depthBuffers;
-VulkanImage* colorBuffers;
-
-VkCommandPool commandPools[FRAMES_IN_FLIGHT];
-VkCommandBuffer commandBuffers[FRAMES_IN_FLIGHT];
-VkFence fences[FRAMES_IN_FLIGHT];
-VkSemaphore acrquireSemaphores[FRAMES_IN_FLIGHT];
-VkSemaphore releaseSemaphores[FRAMES_IN_FLIGHT];
-
-VulkanBuffer spriteVertexBuffer;
-VulkanBuffer spriteIndexBuffer;
-VulkanImage image;
-VkSampler sampler;
-VkDescriptorPool spriteDescriptorPool;
+VulkanImage* colorBuffers;      // multisampled, only with MSAA
+VulkanImage* sceneColorBuffers; // single sampled scene, only with post processing
+uint32_t framebuffersCount = 0;
+uint32_t postFramebuffersCount = 0;
+uint32_t attachmentsCount = 0;
+VkFormat depthFormat;
+
+// Runtime settings (command line / key bindings)
+VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+uint32_t swapchainImageCount = 3;
+uint32_t framesInFlight = 2;
+uint32_t pendingFramesInFlight = 0; // F key, applied before the next acquire, 0 = none
+VkFormat preferredDepthFormat = VK_FORMAT_UNDEFINED; // chosen per device unless requested
+bool useDynamicRendering = false; // VK_KHR_dynamic_rendering instead of render pass + framebuffers
+AntiAliasingMode aaMode = AA_MODE_MSAA;
+VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_4_BIT; // validated against the device limits
+bool renderSettingsChanged = false; // anti aliasing or dynamic resolution toggled, render targets are rebuilt
+
+// Dynamic resolution: the scene is rendered into the top left part of the full size scene
+// color buffer and upscaled with a sharpening pass. renderScale follows the gpu frame time.
+bool dynamicResolution = false;
+double targetGpuTime = 16.0; // ms
+float minRenderScale = 0.5f;
+float sharpness = 0.5f;      // 0..1
+float renderScale = 1.0f;
+
+// Per frame in flight, sized by createFrameResources
+VkCommandPool* commandPools;
+VkCommandBuffer* commandBuffers;
+uint64_t* frameTimelineValues; // graphics timeline value signaled by the last submit of each slot
+VkSemaphore* acrquireSemaphores;
+VkSemaphore* releaseSemaphores;
+
+VulkanBufferHandle spriteVertexBuffer;
+VulkanBufferHandle spriteIndexBuffer;
+VulkanImageHandle image;
+VkSampler sampler; // samplers are owned by the context's sampler cache
 VkDescriptorSet spriteDescriptorSet;
 VkDescriptorSetLayout spriteDescriptorLayout;
 VulkanPipeline spritePipeline;
 
+bool drawSprite = false; // --scene sprite, the textured quad instead of the model
+
 Model model;
-VulkanPipeline modelPipeline;
+VkSampler modelSampler;
+float maxAnisotropy = 16.0f; // --anisotropy, clamped to the device
+VulkanPipeline modelPipeline; // the entry of modelVariants matching shading
+bool modelCulling = true; // --no-culling
+// glTF front faces are counter clockwise in a right handed space, drawn unmirrored with the
+// left handed view (HMM_LookAt_LH) they come out clockwise. --front-face flips it for other assets.
+VkFrontFace modelFrontFace = VK_FRONT_FACE_CLOCKWISE;
+ShadingVariant shading = { SHADING_LIT, VK_TRUE, 16.0f, 0.2f, 0.4f, { 1.0f, 1.0f, -1.0f } };
+ModelVariant modelVariants[MAX_MODEL_VARIANTS]; // oldest first
+uint32_t modelVariantCount;
 VkDescriptorSetLayout modelDescriptorLayout;
-VkDescriptorPool modelDescriptorPool;
-VkDescriptorSet modelDescriptorSets[FRAMES_IN_FLIGHT];
-VulkanBuffer modelUniformBuffers[FRAMES_IN_FLIGHT];
-
-VkQueryPool timestampQueryPools[FRAMES_IN_FLIGHT];
+VkDescriptorSet modelDescriptorSet; // transforms are a dynamic uniform buffer into frameAllocator
+
+// --bindless: textures and materials come from one descriptor set bound once per frame (set 0),
+// modelDescriptorLayout then only holds the transforms (set 1) and draws pass modelMaterial
+bool useBindless = false;
+bool allowPushConstants = true; // --no-push-constants, per draw data always through the frame allocator
+VulkanBindless bindless;
+uint32_t modelMaterial;
+
+VulkanFrameAllocator frameAllocator; // per draw uniforms and dynamic geometry, one region per frame in flight
+
+// Descriptor layouts come from the context's layout cache. Sets living until shutdown are allocated
+// from descriptorAllocator, sets written every frame from the frame slot's transient allocator.
+VulkanDescriptorAllocator descriptorAllocator;
+VulkanDescriptorAllocator* frameDescriptorAllocators; // per frame in flight, reset when the slot is reused
+
+VkSampler postSampler;
+VkDescriptorSetLayout postDescriptorLayout;
+VkDescriptorUpdateTemplate postUpdateTemplate; // the post set is written every frame
+VulkanPipeline postPipeline;
+
+GpuProfiler gpuProfiler; // one set of queries per frame in flight, recreated with the frame resources
+TraceWriter traceWriter;  // --trace, chrome trace of the cpu and gpu scopes
+uint32_t cpuStatsWindow = 0; // --cpu-stats, frames per cpu phase report (0 = off)
+double memoryStatsInterval = 0.0; // --memory-stats, seconds between memory reports (0 = off)
+uint32_t descriptorBenchSets = 0;  // --descriptor-bench, sets written per round (0 = off)
+Benchmark bench = { .warmupFrames = BENCH_DEFAULT_WARMUP }; // --bench, scripted camera and fixed time step
+bool headless = false;          // --headless, GLFW null platform presenting to a VK_EXT_headless_surface
+bool enableValidation = true;   // --no-validation
+bool presentModeRequested = false;
+double sceneTime = 0.0;         // drives the animation, the wall clock or the benchmark's fixed steps
+uint64_t renderedFrames = 0;
+
+// --capture: the presented image of one frame is copied back through a readback ring,
+// written out and/or compared against a golden image once the gpu finished it
+VkImageUsageFlags swapchainUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+VulkanReadbackRing readbackRing;
+VulkanReadbackSlot* pendingReadback; // recorded this frame, gets the submit value
+int64_t captureFrame = -1;
+const char* captureOutputPath;
+const char* goldenPath;
+const char* goldenDiffPath;
+uint32_t goldenTolerance = 2;      // per channel, absorbs rounding differences between drivers
+double goldenMaxMismatch = 0.001;  // fraction of pixels allowed to exceed the tolerance
+bool captureDone = false;
+bool goldenFailed = false;
+FrameTiming* frameTimings;
 
 Camera camera;
 
+// Transforms of everything drawn, updated once per frame before recording
+Scene scene;
+SceneNode modelNode;
+uint32_t sceneThreads = 0;    // --scene-threads, 0 = one per cpu
+uint32_t sceneStressNodes = 0; // --scene-nodes, moving nodes that are updated but not drawn
+SceneNode sceneStressRoot = SCENE_INVALID_NODE;
+
 uint32_t frameIndex = 0;
+uint32_t imageIndex = 0;
 bool framebufferResized = false;
+bool swapchainSettingsChanged = false;
+
+// Low latency mode: sleep after acquire until the gpu is about to go idle
+// and only then sample input, so the frame is built from fresh input.
+bool lowLatencyMode = false;
+bool reportLatency = false;
+double gpuFrameTimeAvg = 0.0;      // ms, from timestamp queries
+double cpuRecordTimeAvg = 0.0;     // ms, input sampling -> submit
+double latencyAvg = 0.0;           // ms, estimated input -> present
+double lastSubmitTime = 0.0;
+double lastInputTime = 0.0;
 bool disCursorMode = false;
 
 double lastMouseX = 0.0f;
@@ -121,6 +296,371 @@ void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
     framebufferResized = true;
 }
 
+static const char* antiAliasingName() {
+    static char name[16];
+    if (aaMode == AA_MODE_FXAA) return "FXAA";
+    if (msaaSamples == VK_SAMPLE_COUNT_1_BIT) return "off";
+    snprintf(name, sizeof(name), "%ux MSAA", msaaSamples);
+    return name;
+}
+
+// off -> 2x -> 4x -> 8x MSAA -> FXAA -> off, skipping sample counts the device does not support
+static void cycleAntiAliasing() {
+    if (aaMode == AA_MODE_FXAA) {
+        aaMode = AA_MODE_MSAA;
+        msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+    }
+    else {
+        VkSampleCountFlagBits next = (VkSampleCountFlagBits)(msaaSamples << 1);
+        while (next <= VK_SAMPLE_COUNT_8_BIT && !isSampleCountSupported(context, next)) {
+            next = (VkSampleCountFlagBits)(next << 1);
+        }
+
+        if (next > VK_SAMPLE_COUNT_8_BIT) aaMode = AA_MODE_FXAA;
+        else msaaSamples = next;
+    }
+    renderSettingsChanged = true;
+}
+
+static const char* shadingModeName(uint32_t mode) {
+    switch (mode) {
+        case SHADING_LIT: return "lit";
+        case SHADING_NORMALS: return "normals";
+        case SHADING_UNLIT: return "unlit";
+        default: return "?";
+    }
+}
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (action != GLFW_PRESS) return;
+
+    if (key == GLFW_KEY_P) {
+        VkPresentModeKHR modes[] = {
+            VK_PRESENT_MODE_FIFO_KHR,
+            VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+            VK_PRESENT_MODE_MAILBOX_KHR,
+            VK_PRESENT_MODE_IMMEDIATE_KHR,
+        };
+        uint32_t next = 0;
+        for (uint32_t i = 0; i < ARRAY_COUNT(modes); i++) {
+            if (modes[i] == presentMode) next = (i + 1) % ARRAY_COUNT(modes);
+        }
+        presentMode = modes[next];
+        swapchainSettingsChanged = true;
+        printf("Present mode: %s\n", presentModeName(presentMode));
+    }
+    else if (key == GLFW_KEY_I) {
+        swapchainImageCount = swapchainImageCount >= 4 ? 2 : swapchainImageCount + 1;
+        swapchainSettingsChanged = true;
+        printf("Swapchain images: %u\n", swapchainImageCount);
+    }
+    else if (key == GLFW_KEY_F) {
+        // in low latency mode input is sampled after the acquire, the frame resources
+        // can not be rebuilt while the acquired image waits to be rendered
+        uint32_t current = pendingFramesInFlight ? pendingFramesInFlight : framesInFlight;
+        pendingFramesInFlight = current >= 3 ? 1 : current + 1;
+        printf("Frames in flight: %u\n", pendingFramesInFlight);
+    }
+    else if (key == GLFW_KEY_L) {
+        lowLatencyMode = !lowLatencyMode;
+        printf("Low latency mode: %s\n", lowLatencyMode ? "on" : "off");
+    }
+    else if (key == GLFW_KEY_M) {
+        cycleAntiAliasing();
+        printf("Anti aliasing: %s\n", antiAliasingName());
+    }
+    else if (key == GLFW_KEY_R) {
+        dynamicResolution = !dynamicResolution;
+        renderScale = 1.0f;
+        renderSettingsChanged = true;
+        printf("Dynamic resolution: %s\n", dynamicResolution ? "on" : "off");
+    }
+    else if (key == GLFW_KEY_V) {
+        shading.mode = (shading.mode + 1) % SHADING_MODE_COUNT;
+        selectModelVariant();
+        printf("Shading: %s (%u pipeline variants)\n", shadingModeName(shading.mode), modelVariantCount);
+    }
+}
+
+static void* allocFrameArray(size_t elementSize, const char* name) {
+    void* result = calloc(framesInFlight, elementSize);
+    if (!result) {
+        fprintf(stderr, "Failed to allocate %s!\n", name);
+        exit(-1);
+    }
+    return result;
+}
+
+// Everything that is duplicated per frame in flight. Can be recreated at runtime
+// to change the number of frames in flight.
+void createFrameResources() {
+    commandPools = allocFrameArray(sizeof(VkCommandPool), "commandPools");
+    commandBuffers = allocFrameArray(sizeof(VkCommandBuffer), "commandBuffers");
+    frameTimelineValues = allocFrameArray(sizeof(uint64_t), "frameTimelineValues");
+    acrquireSemaphores = allocFrameArray(sizeof(VkSemaphore), "acrquireSemaphores");
+    releaseSemaphores = allocFrameArray(sizeof(VkSemaphore), "releaseSemaphores");
+    frameTimings = allocFrameArray(sizeof(FrameTiming), "frameTimings");
+    frameDescriptorAllocators = allocFrameArray(sizeof(VulkanDescriptorAllocator), "frameDescriptorAllocators");
+
+    if (!createFrameAllocator(context, &frameAllocator, FRAME_ALLOCATOR_SIZE, framesInFlight)) {
+        exit(-1);
+    }
+
+    // one set for all frames, the dynamic offset selects the frame's transforms. The frame
+    // allocator was recreated, the device is idle so the set can be rewritten.
+    {
+        // the bindless layout has no texture binding, its template ignores the second info
+        VulkanDescriptorInfo infos[2] = {0};
+        infos[0].buffer.buffer = frameAllocator.buffer.buffer;
+        infos[0].buffer.offset = 0;
+        infos[0].buffer.range = sizeof(ModelTransforms);
+        infos[1].image.sampler = modelSampler;
+        infos[1].image.imageView = getImage(context, model.albedoTexture)->view;
+        infos[1].image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        vkUpdateDescriptorSetWithTemplate(context->device, modelDescriptorSet, getDescriptorUpdateTemplate(context, modelDescriptorLayout), infos);
+    }
+
+    createGpuProfiler(context, &gpuProfiler, framesInFlight);
+
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        VkSemaphoreCreateInfo createInfo = {0};
+        createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        if (vkCreateSemaphore(context->device, &createInfo, NULL, &acrquireSemaphores[i]) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create semaphore!\n");
+            exit(1);
+        }
+        if (vkCreateSemaphore(context->device, &createInfo, NULL, &releaseSemaphores[i]) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create semaphore!\n");
+            exit(1);
+        }
+    }
+
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        VkCommandPoolCreateInfo createInfo = {0};
+        createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        createInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        createInfo.queueFamilyIndex = context->graphicsQueue.familyIndex;
+
+        if (vkCreateCommandPool(context->device, &createInfo, NULL, &commandPools[i]) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create Commandpool!\n");
+            exit(-1);
+        }
+    }
+
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+    
+        VkCommandBufferAllocateInfo allocInfo = {0};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        allocInfo.commandPool = commandPools[i];
+
+        if (vkAllocateCommandBuffers(context->device, &allocInfo, &commandBuffers[i]) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create commandbuffer!\n");
+            exit(-1);
+        }
+    }
+}
+
+void destroyFrameResources() {
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        vkDestroySemaphore(context->device, acrquireSemaphores[i], NULL);
+        vkDestroySemaphore(context->device, releaseSemaphores[i], NULL);
+        vkDestroyCommandPool(context->device, commandPools[i], NULL);
+    }
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        destroyDescriptorAllocator(context, &frameDescriptorAllocators[i]);
+    }
+    destroyFrameAllocator(context, &frameAllocator);
+    destroyGpuProfiler(&gpuProfiler);
+
+    free(commandPools);
+    free(commandBuffers);
+    free(frameTimelineValues);
+    free(acrquireSemaphores);
+    free(releaseSemaphores);
+    free(frameTimings);
+    free(frameDescriptorAllocators);
+}
+
+void setFramesInFlight(uint32_t count) {
+    vkDeviceWaitIdle(context->device);
+    destroyFrameResources();
+    framesInFlight = count;
+    frameIndex = 0;
+    createFrameResources();
+    recreateRenderPass();
+}
+
+static VulkanPipeline acquireModelPipeline(const ShadingVariant* variant) {
+    VkVertexInputAttributeDescription modelAttributeDescriptions[3] = {0};
+    modelAttributeDescriptions[0].binding = 0;
+    modelAttributeDescriptions[0].location = 0;
+    modelAttributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    modelAttributeDescriptions[0].offset = 0;
+
+    modelAttributeDescriptions[1].binding = 0;
+    modelAttributeDescriptions[1].location = 1;
+    modelAttributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+    modelAttributeDescriptions[1].offset = sizeof(float) * 3;
+
+    modelAttributeDescriptions[2].binding = 0;
+    modelAttributeDescriptions[2].location = 2;
+    modelAttributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+    modelAttributeDescriptions[2].offset = sizeof(float) * 6;
+
+    VkVertexInputBindingDescription modelInputBinding = {0};
+    modelInputBinding.binding = 0;
+    modelInputBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    modelInputBinding.stride = sizeof(float) * 8;
+
+    VkSpecializationMapEntry specializationEntries[] = {
+        { 0, offsetof(ShadingVariant, mode), sizeof(uint32_t) },
+        { 1, offsetof(ShadingVariant, specular), sizeof(VkBool32) },
+        { 2, offsetof(ShadingVariant, shininess), sizeof(float) },
+        { 3, offsetof(ShadingVariant, ambient), sizeof(float) },
+        { 4, offsetof(ShadingVariant, specularWeight), sizeof(float) },
+        { 5, offsetof(ShadingVariant, lightDirection[0]), sizeof(float) },
+        { 6, offsetof(ShadingVariant, lightDirection[1]), sizeof(float) },
+        { 7, offsetof(ShadingVariant, lightDirection[2]), sizeof(float) },
+    };
+
+    VkSpecializationInfo specialization = {0};
+    specialization.mapEntryCount = ARRAY_COUNT(specializationEntries);
+    specialization.pMapEntries = specializationEntries;
+    specialization.dataSize = sizeof(ShadingVariant);
+    specialization.pData = variant;
+
+    // the transforms are push constants when they fit, the shaders are built for both (the %_vert_push.spv rule in the Makefile)
+    VulkanDrawDataLayout modelDrawData = selectDrawDataLayout(context, sizeof(ModelTransforms), VK_SHADER_STAGE_VERTEX_BIT,
+                                                              useBindless ? 1 : 0, allowPushConstants);
+
+    // opaque: no blending, and back faces are hidden behind front faces anyway
+    VulkanPipelineDesc desc = defaultPipelineDesc();
+    desc.fragSpecialization = &specialization;
+    desc.attributes = modelAttributeDescriptions;
+    desc.attributeCount = ARRAY_COUNT(modelAttributeDescriptions);
+    desc.binding = &modelInputBinding;
+    desc.drawData = &modelDrawData;
+    desc.cullMode = modelCulling ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
+    desc.frontFace = modelFrontFace;
+    desc.renderPass = useDynamicRendering ? VK_NULL_HANDLE : renderPass;
+    desc.formats = (VulkanRenderingFormats){ swapchain.format, depthFormat, sampleCount };
+
+    VkDescriptorSetLayout bindlessSetLayouts[] = { bindless.layout, modelDescriptorLayout };
+    if (useBindless) {
+        desc.vertPath = modelDrawData.pushConstants ? ASSET_DIR "/shaders/model_bindless_vert_push.spv" :
+                                                      ASSET_DIR "/shaders/model_bindless_vert.spv";
+        desc.fragPath = ASSET_DIR "/shaders/model_bindless_frag.spv";
+        desc.setLayouts = bindlessSetLayouts;
+        desc.setLayoutCount = ARRAY_COUNT(bindlessSetLayouts);
+    }
+    else {
+        desc.vertPath = modelDrawData.pushConstants ? ASSET_DIR "/shaders/model_vert_push.spv" :
+                                                      ASSET_DIR "/shaders/model_vert.spv";
+        desc.fragPath = ASSET_DIR "/shaders/model_frag.spv";
+        desc.setLayouts = &modelDescriptorLayout;
+        desc.setLayoutCount = 1;
+    }
+
+    return acquirePipeline(context, &desc);
+}
+
+// Points modelPipeline at the pipeline for the current shading variant, creating it on first use.
+// The pipeline cache only spares the driver the compile, the variants spare building and hashing the description.
+void selectModelVariant() {
+    uint64_t key = hashBytes(VULKAN_HASH_SEED, &shading, sizeof(shading));
+
+    for (uint32_t i = 0; i < modelVariantCount; i++) {
+        if (modelVariants[i].key == key && memcmp(&modelVariants[i].variant, &shading, sizeof(shading)) == 0) {
+            modelPipeline = modelVariants[i].pipeline;
+            return;
+        }
+    }
+
+    if (modelVariantCount == MAX_MODEL_VARIANTS) {
+        releasePipeline(context, &modelVariants[0].pipeline, context->graphicsQueue.timelineValue);
+        memmove(&modelVariants[0], &modelVariants[1], sizeof(ModelVariant) * (MAX_MODEL_VARIANTS - 1));
+        modelVariantCount--;
+    }
+
+    ModelVariant* entry = &modelVariants[modelVariantCount++];
+    entry->key = key;
+    entry->variant = shading;
+    entry->pipeline = acquireModelPipeline(&shading);
+    modelPipeline = entry->pipeline;
+}
+
+// Pipelines bake in the sample count and, without render passes, the attachment formats,
+// so they are recreated together with the render targets when those change
+void createPipelines() {
+    VkVertexInputAttributeDescription vertexAttributeDescriptions[3] = {0};
+    vertexAttributeDescriptions[0].binding = 0;
+    vertexAttributeDescriptions[0].location = 0;
+    vertexAttributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+    vertexAttributeDescriptions[0].offset = 0;
+
+    vertexAttributeDescriptions[1].binding = 0;
+    vertexAttributeDescriptions[1].location = 1;
+    vertexAttributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+    vertexAttributeDescriptions[1].offset = sizeof(float) * 2;
+
+    vertexAttributeDescriptions[2].binding = 0;
+    vertexAttributeDescriptions[2].location = 2;
+    vertexAttributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+    vertexAttributeDescriptions[2].offset = sizeof(float) * 5;
+
+    VkVertexInputBindingDescription vertexInputBinding = {0};
+    vertexInputBinding.binding = 0;
+    vertexInputBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    vertexInputBinding.stride = sizeof(float) * 7;
+
+
+    // the sprite texture has transparent parts and the quad may be seen from both sides
+    VulkanPipelineDesc spriteDesc = defaultPipelineDesc();
+    spriteDesc.vertPath = ASSET_DIR "/shaders/texture_vert.spv";
+    spriteDesc.fragPath = ASSET_DIR "/shaders/texture_frag.spv";
+    spriteDesc.attributes = vertexAttributeDescriptions;
+    spriteDesc.attributeCount = ARRAY_COUNT(vertexAttributeDescriptions);
+    spriteDesc.binding = &vertexInputBinding;
+    spriteDesc.setLayouts = &spriteDescriptorLayout;
+    spriteDesc.setLayoutCount = 1;
+    spriteDesc.cullMode = VK_CULL_MODE_NONE;
+    spriteDesc.blend = VULKAN_BLEND_ALPHA;
+    spriteDesc.renderPass = useDynamicRendering ? VK_NULL_HANDLE : renderPass;
+    spriteDesc.formats = (VulkanRenderingFormats){ swapchain.format, depthFormat, sampleCount };
+    spritePipeline = acquirePipeline(context, &spriteDesc);
+
+    modelVariantCount = 0;
+    selectModelVariant();
+
+    if (postProcessing) {
+        VulkanRenderingFormats postFormats = { swapchain.format, VK_FORMAT_UNDEFINED, VK_SAMPLE_COUNT_1_BIT };
+
+        VkPushConstantRange postPushConstant = {0};
+        postPushConstant.offset = 0;
+        postPushConstant.size = sizeof(PostParams);
+        postPushConstant.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        // FXAA upscales as well, otherwise the post pass only upscales and sharpens
+        const char* postFragPath = fxaaEnabled ? ASSET_DIR "/shaders/fxaa_frag.spv" :
+                                                 ASSET_DIR "/shaders/upscale_frag.spv";
+
+        VulkanPipelineDesc postDesc = defaultPipelineDesc();
+        postDesc.vertPath = ASSET_DIR "/shaders/fullscreen_vert.spv";
+        postDesc.fragPath = postFragPath;
+        postDesc.setLayouts = &postDescriptorLayout;
+        postDesc.setLayoutCount = 1;
+        postDesc.pushConstant = &postPushConstant;
+        postDesc.cullMode = VK_CULL_MODE_NONE;
+        postDesc.depthTest = false;
+        postDesc.renderPass = useDynamicRendering ? VK_NULL_HANDLE : postRenderPass;
+        postDesc.formats = postFormats;
+        postPipeline = acquirePipeline(context, &postDesc);
+    }
+}
+
 void initApplication(GLFWwindow* window) {
     uint32_t glfwExtensionCount = 0;
     const char** glfwExtensions;
@@ -132,7 +672,9 @@ void initApplication(GLFWwindow* window) {
         VK_EXT_VALIDATION_FEATURES_EXTENSION_NAME
     };
 
-    uint32_t totalInstanceExtensionCount = glfwExtensionCount + ARRAY_COUNT(additionalInstanceExtensions);
+    // both come with the validation layer
+    uint32_t additionalInstanceExtensionCount = enableValidation ? ARRAY_COUNT(additionalInstanceExtensions) : 0;
+    uint32_t totalInstanceExtensionCount = glfwExtensionCount + additionalInstanceExtensionCount;
     const char** enabledInstanceExtensions = malloc(sizeof(char*) * totalInstanceExtensionCount);
     if (!enabledInstanceExtensions) {
         fprintf(stderr, "Failed to allocate memory for enabledInstanceExtensions!\n");
@@ -145,7 +687,7 @@ void initApplication(GLFWwindow* window) {
     }
 
     // copy additional
-    for (uint32_t i = 0; i < ARRAY_COUNT(additionalInstanceExtensions); i++) {
+    for (uint32_t i = 0; i < additionalInstanceExtensionCount; i++) {
         enabledInstanceExtensions[glfwExtensionCount + i] = additionalInstanceExtensions[i];
     }
 
@@ -153,7 +695,7 @@ void initApplication(GLFWwindow* window) {
         "VK_KHR_swapchain"
     };
 
-    context = initVulkan(totalInstanceExtensionCount, enabledInstanceExtensions, ARRAY_COUNT(enabledDeviceExtensions), enabledDeviceExtensions);
+    context = initVulkan(totalInstanceExtensionCount, enabledInstanceExtensions, ARRAY_COUNT(enabledDeviceExtensions), enabledDeviceExtensions, enableValidation);
     if (!context) {
         fprintf(stderr, "Failed to create vulkan context!\n");
         return;
@@ -172,37 +714,71 @@ void initApplication(GLFWwindow* window) {
         exit(-1);
     }
 
-    swapchain = createSwapchain(window, context, surface, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0);
+    if (useDynamicRendering && !context->supportsDynamicRendering) {
+        fprintf(stderr, "VK_KHR_dynamic_rendering not supported, using render passes!\n");
+        useDynamicRendering = false;
+    }
+
+    swapchain = createSwapchain(window, context, surface, swapchainUsage, presentMode, swapchainImageCount, 0);
+
+    depthFormat = selectDepthFormat(context, preferredDepthFormat);
+    msaaSamples = selectSampleCount(context, msaaSamples);
+
+    // Post processing reads the scene color with a linear sampler
+    {
+        VulkanSamplerDesc samplerDesc = {0};
+        samplerDesc.magFilter = VK_FILTER_LINEAR;
+        samplerDesc.minFilter = VK_FILTER_LINEAR;
+        samplerDesc.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerDesc.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerDesc.addressModeV = samplerDesc.addressModeU;
+        samplerDesc.addressModeW = samplerDesc.addressModeU;
+
+        postSampler = getSampler(context, &samplerDesc);
+        if (!postSampler) {
+            exit(-1);
+        }
+
+        VkDescriptorSetLayoutBinding bindings[] = {
+            { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, 0 },
+        };
+
+        postDescriptorLayout = getDescriptorSetLayout(context, bindings, ARRAY_COUNT(bindings));
+        postUpdateTemplate = getDescriptorUpdateTemplate(context, postDescriptorLayout);
+        if (!postDescriptorLayout || !postUpdateTemplate) {
+            exit(-1);
+        }
+    }
 
     recreateRenderPass();
 
     // Load Model
-    //model = createModel(context, "/home/ttchef/coding/c/Vulkan-Hello-Triangle/res/models/monkey.glb");
-    model = createModel(context, "/home/ttchef/coding/c/Vulkan-Hello-Triangle/res/models/BoomBox.glb");
+    model = createModel(context, ASSET_DIR "/res/models/monkey.glb");
 
+    // the sprite keeps its pixel look, the model samples the way its glTF asks for
     {
-        VkSamplerCreateInfo createInfo = {0};
-        createInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-        createInfo.magFilter = VK_FILTER_NEAREST;
-        createInfo.minFilter = VK_FILTER_NEAREST;
-        createInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-        createInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-        createInfo.addressModeV = createInfo.addressModeU;
-        createInfo.addressModeW = createInfo.addressModeU;
-        createInfo.mipLodBias = 0.0f;
-        createInfo.maxAnisotropy = 1.0f;
-        createInfo.minLod = 0.0f;
-        createInfo.maxLod = 1.0f;
-
-        if (vkCreateSampler(context->device, &createInfo, NULL, &sampler) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to create sampler!\n");
+        VulkanSamplerDesc samplerDesc = {0};
+        samplerDesc.magFilter = VK_FILTER_NEAREST;
+        samplerDesc.minFilter = VK_FILTER_NEAREST;
+        samplerDesc.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerDesc.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerDesc.addressModeV = samplerDesc.addressModeU;
+        samplerDesc.addressModeW = samplerDesc.addressModeU;
+        samplerDesc.maxLod = 1.0f;
+        sampler = getSampler(context, &samplerDesc);
+
+        VulkanSamplerDesc modelSamplerDesc = model.albedoSampler;
+        modelSamplerDesc.maxAnisotropy = maxAnisotropy;
+        modelSampler = getSampler(context, &modelSamplerDesc);
+
+        if (!sampler || !modelSampler) {
             exit(-1);
         }
     }
 
     {
 
-        const char* path = "/home/ttchef/coding/c/Vulkan-Hello-Triangle/res/images/arch.png";
+        const char* path = ASSET_DIR "/res/images/arch.png";
         int width, height, channels;
         uint8_t* data = stbi_load(path, &width, &height, &channels, 4);
         if (!data) {
@@ -210,465 +786,638 @@ void initApplication(GLFWwindow* window) {
             exit(-1);
         }
 
-        createImage(context, &image, width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT);
-        uploadDataToImage(context, &image, data, width * height * 4,
+        image = createPooledImage(context, width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                  VK_SAMPLE_COUNT_1_BIT, VULKAN_MEMORY_TEXTURE);
+        uploadDataToImage(context, getImage(context, image), data, width * height * 4,
                           width, height, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
         stbi_image_free(data);
     }
 
-    {
-
-        VkDescriptorPoolSize poolSizes[] = {
-            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1},
-        };
-
-        VkDescriptorPoolCreateInfo createInfo = {0};
-        createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        createInfo.maxSets = 1;
-        createInfo.poolSizeCount = ARRAY_COUNT(poolSizes);
-        createInfo.pPoolSizes = poolSizes;
-
-        if (vkCreateDescriptorPool(context->device, &createInfo, NULL, &spriteDescriptorPool) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to create descriptorPool!\n");
-            exit(-1);
-        }
-    }
-
     {
         VkDescriptorSetLayoutBinding bindings[] = {
             { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, 0 },
         };
 
-
-        VkDescriptorSetLayoutCreateInfo createInfo = {0};
-        createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        createInfo.bindingCount = ARRAY_COUNT(bindings);
-        createInfo.pBindings = bindings;
-
-        if (vkCreateDescriptorSetLayout(context->device, &createInfo, NULL, &spriteDescriptorLayout) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to create descriptor layout!\n");
-            exit(-1);
-        }
-
-        VkDescriptorSetAllocateInfo allocInfo = {0};
-        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        allocInfo.descriptorPool = spriteDescriptorPool;
-        allocInfo.descriptorSetCount = 1;
-        allocInfo.pSetLayouts = &spriteDescriptorLayout;
-
-        if (vkAllocateDescriptorSets(context->device, &allocInfo, &spriteDescriptorSet) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to allocate descriptor set!\n");
+        spriteDescriptorLayout = getDescriptorSetLayout(context, bindings, ARRAY_COUNT(bindings));
+        spriteDescriptorSet = allocateDescriptorSet(context, &descriptorAllocator, spriteDescriptorLayout);
+        if (!spriteDescriptorSet) {
             exit(-1);
         }
 
-        VkDescriptorImageInfo imageInfo = {0};
-        imageInfo.sampler = sampler;
-        imageInfo.imageView = image.view;
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        VulkanDescriptorInfo info = {0};
+        info.image.sampler = sampler;
+        info.image.imageView = getImage(context, image)->view;
+        info.image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-        VkWriteDescriptorSet descriptorWrites[1];
-        descriptorWrites[0] = (VkWriteDescriptorSet){0};
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = spriteDescriptorSet;
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[0].pImageInfo = &imageInfo;
-
-        vkUpdateDescriptorSets(context->device, ARRAY_COUNT(descriptorWrites), descriptorWrites, 0, NULL);
+        vkUpdateDescriptorSetWithTemplate(context->device, spriteDescriptorSet, getDescriptorUpdateTemplate(context, spriteDescriptorLayout), &info);
     }
 
    {
-
-        VkDescriptorPoolSize poolSizes[] = {
-            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, FRAMES_IN_FLIGHT },
-            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, FRAMES_IN_FLIGHT },
+        VkDescriptorSetLayoutBinding bindings[] = {
+            { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT, 0 },
+            { 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, &modelSampler }, // &modelSampler is optional as immutable
         };
 
-        VkDescriptorPoolCreateInfo createInfo = {0};
-        createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        createInfo.maxSets = FRAMES_IN_FLIGHT;
-        createInfo.poolSizeCount = ARRAY_COUNT(poolSizes);
-        createInfo.pPoolSizes = poolSizes;
+        if (useBindless && !createBindless(context, &bindless, VULKAN_BINDLESS_MAX_TEXTURES, VULKAN_BINDLESS_MAX_MATERIALS)) {
+            useBindless = false;
+        }
+        if (useBindless) {
+            VulkanMaterial material = {0};
+            memcpy(material.baseColorFactor, model.baseColorFactor, sizeof(material.baseColorFactor));
+            material.albedoTexture = bindlessAddTexture(context, &bindless, getImage(context, model.albedoTexture)->view, modelSampler);
+            if (material.albedoTexture == UINT32_MAX) {
+                exit(-1);
+            }
+            modelMaterial = bindlessAddMaterial(&bindless, &material);
+            if (modelMaterial == UINT32_MAX) {
+                exit(-1);
+            }
+        }
 
-        if (vkCreateDescriptorPool(context->device, &createInfo, NULL, &modelDescriptorPool) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to create descriptorPool!\n");
+        // written by createFrameResources
+        modelDescriptorLayout = getDescriptorSetLayout(context, bindings, useBindless ? 1 : ARRAY_COUNT(bindings));
+        modelDescriptorSet = allocateDescriptorSet(context, &descriptorAllocator, modelDescriptorLayout);
+        if (!modelDescriptorSet) {
             exit(-1);
         }
     }
 
-    // Uniform buffers
-    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
-        createBuffer(context, &modelUniformBuffers[i], sizeof(HMM_Mat4) * 2, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    }
+    createFrameResources();
 
-   {
-        VkDescriptorSetLayoutBinding bindings[] = {
-            { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, 0 },
-            { 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, &sampler }, // &sampler is optional as immutable
-        };
+    createPipelines();
 
+    spriteVertexBuffer = createPooledBuffer(context, sizeof(vertexData), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                            VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VULKAN_MEMORY_GEOMETRY);
+    uploadDataToBuffer(context, getBuffer(context, spriteVertexBuffer), vertexData, sizeof(vertexData));
 
-        VkDescriptorSetLayoutCreateInfo createInfo = {0};
-        createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        createInfo.bindingCount = ARRAY_COUNT(bindings);
-        createInfo.pBindings = bindings;
 
-        if (vkCreateDescriptorSetLayout(context->device, &createInfo, NULL, &modelDescriptorLayout) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to create descriptor layout!\n");
-            exit(-1);
-        }
+    spriteIndexBuffer = createPooledBuffer(context, sizeof(indexData), VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                                           VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VULKAN_MEMORY_GEOMETRY);
+    uploadDataToBuffer(context, getBuffer(context, spriteIndexBuffer), indexData, sizeof(indexData));
+
+    // Camera
+    {
+        camera.cameraPosition = HMM_V3(0.0f, 0.0f, 0.0f);
+        camera.cameraDirection = HMM_V3(0.0f, 0.0f, 1.0f);
 
-        for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
-            VkDescriptorSetAllocateInfo allocInfo = {0};
-            allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-            allocInfo.descriptorPool = modelDescriptorPool;
-            allocInfo.descriptorSetCount = 1;
-            allocInfo.pSetLayouts = &modelDescriptorLayout;
+        camera.up = HMM_V3(0.0f, 1.0f, 0.0f);
+        camera.yaw = 0.0f;
+        camera.pitch = 0.0f;
+    }
 
-            if (vkAllocateDescriptorSets(context->device, &allocInfo, &modelDescriptorSets[i]) != VK_SUCCESS) {
-                fprintf(stderr, "Failed to allocate descriptor set!\n");
+    if (!createScene(&scene, 1 + sceneStressNodes, sceneThreads)) {
+        exit(-1);
+    }
+    HMM_Mat4 identity = HMM_M4D(1.0f);
+    modelNode = sceneAddNode(&scene, SCENE_NO_PARENT, &identity);
+
+    // eight children per node below one root that turns every frame, so the whole tree is dirty
+    if (sceneStressNodes) {
+        HMM_Mat4 offset = HMM_MulM4(HMM_Translate(HMM_V3(0.5f, 0.0f, 0.0f)), HMM_Scale(HMM_V3(0.5f, 0.5f, 0.5f)));
+        sceneStressRoot = sceneAddNode(&scene, SCENE_NO_PARENT, &identity);
+        for (uint32_t i = 1; i < sceneStressNodes; i++) {
+            if (sceneAddNode(&scene, sceneStressRoot + (i - 1) / 8, &offset) == SCENE_INVALID_NODE) {
                 exit(-1);
             }
+        }
+    }
+}
 
-            VkDescriptorBufferInfo bufferInfo = {0};
-            bufferInfo.buffer = modelUniformBuffers[i].buffer;
-            bufferInfo.offset = 0;
-            bufferInfo.range = sizeof(HMM_Mat4) * 2;
-
-            VkDescriptorImageInfo imageInfo = {0};
-            imageInfo.sampler = sampler;
-            imageInfo.imageView = model.albedoTexture.view;
-            imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-            VkWriteDescriptorSet descriptorWrites[2];
-            descriptorWrites[0] = (VkWriteDescriptorSet){0};
-            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[0].dstSet = modelDescriptorSets[i];
-            descriptorWrites[0].dstBinding = 0;
-            descriptorWrites[0].descriptorCount = 1;
-            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            descriptorWrites[0].pBufferInfo = &bufferInfo;
+static void* reallocRenderTargetArray(void* array, uint32_t count, size_t elementSize, const char* name) {
+    // + 1 so an empty array is still a valid allocation
+    void* result = realloc(array, elementSize * (count + 1));
+    if (!result) {
+        fprintf(stderr, "Failed to reallocate %s!\n", name);
+        exit(-1);
+    }
+    return result;
+}
 
-            descriptorWrites[1] = (VkWriteDescriptorSet){0};
-            descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[1].dstSet = modelDescriptorSets[i];
-            descriptorWrites[1].dstBinding = 1;
-            descriptorWrites[1].descriptorCount = 1;
-            descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            descriptorWrites[1].pImageInfo = &imageInfo;
+// Recreates the attachments (one set per frame in flight) and, for the render pass path, the
+// framebuffers. Render passes and pipelines are only recreated when the swapchain format or
+// the anti aliasing mode changed. The old objects are handed to the deletion queue, frames
+// in flight may still use them.
+void recreateRenderPass() {
+    uint64_t retireValue = context->graphicsQueue.timelineValue;
 
-            vkUpdateDescriptorSets(context->device, ARRAY_COUNT(descriptorWrites), descriptorWrites, 0, NULL);
+    for (uint32_t i = 0; i < framebuffersCount; i++) {
+        deferDestroyFramebuffer(context, framebuffers[i], retireValue);
+    }
+    for (uint32_t i = 0; i < postFramebuffersCount; i++) {
+        deferDestroyFramebuffer(context, postFramebuffers[i], retireValue);
+    }
+    for (uint32_t i = 0; i < attachmentsCount; i++) {
+        deferDestroyImage(context, &depthBuffers[i]);
+        if (colorBuffers[i].image) deferDestroyImage(context, &colorBuffers[i]);
+        if (sceneColorBuffers[i].image) deferDestroyImage(context, &sceneColorBuffers[i]);
+    }
+    VkSampleCountFlagBits samples = aaMode == AA_MODE_MSAA ? msaaSamples : VK_SAMPLE_COUNT_1_BIT;
+    bool fxaa = aaMode == AA_MODE_FXAA;
+    bool postProcess = fxaa || dynamicResolution;
+
+    // a resize can keep render passes and pipelines
+    bool settingsChanged = renderPassFormat != swapchain.format || sampleCount != samples ||
+                           postProcessing != postProcess || fxaaEnabled != fxaa;
+    renderPassFormat = swapchain.format;
+    sampleCount = samples;
+    postProcessing = postProcess;
+    fxaaEnabled = fxaa;
+
+    if (settingsChanged) {
+        if (renderPass) {
+            deferDestroyRenderPass(context, renderPass, retireValue);
+            renderPass = VK_NULL_HANDLE;
+        }
+        if (postRenderPass) {
+            deferDestroyRenderPass(context, postRenderPass, retireValue);
+            postRenderPass = VK_NULL_HANDLE;
+        }
+    }
 
+    if (!renderPass && !useDynamicRendering) {
+        VkImageLayout sceneLayout = postProcessing ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        renderPass = createRenderPass(context, swapchain.format, depthFormat, sampleCount, sceneLayout);
+        if (postProcessing) {
+            postRenderPass = createRenderPass(context, swapchain.format, VK_FORMAT_UNDEFINED, VK_SAMPLE_COUNT_1_BIT,
+                                              VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
         }
+    }
 
-     }
+    // dynamic rendering binds the attachments at record time
+    attachmentsCount = framesInFlight;
+    if (useDynamicRendering) {
+        framebuffersCount = 0;
+        postFramebuffersCount = 0;
+    }
+    else if (postProcessing) {
+        framebuffersCount = framesInFlight;
+        postFramebuffersCount = swapchain.imagesCount;
+    }
+    else {
+        framebuffersCount = framesInFlight * swapchain.imagesCount;
+        postFramebuffersCount = 0;
+    }
 
-    // Query Pool 
-    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
-        VkQueryPoolCreateInfo createInfo = {0};
-        createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
-        createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
-        createInfo.queryCount = 64; // one minecraft stack
+    framebuffers = reallocRenderTargetArray(framebuffers, framebuffersCount, sizeof(VkFramebuffer), "framebuffers");
+    postFramebuffers = reallocRenderTargetArray(postFramebuffers, postFramebuffersCount, sizeof(VkFramebuffer), "postFramebuffers");
+    depthBuffers = reallocRenderTargetArray(depthBuffers, attachmentsCount, sizeof(VulkanImage), "depthBuffers");
+    colorBuffers = reallocRenderTargetArray(colorBuffers, attachmentsCount, sizeof(VulkanImage), "colorBuffers");
+    sceneColorBuffers = reallocRenderTargetArray(sceneColorBuffers, attachmentsCount, sizeof(VulkanImage), "sceneColorBuffers");
+
+    for (uint32_t i = 0; i < attachmentsCount; i++) {
+        createImage(context, &depthBuffers[i], swapchain.width, swapchain.height, depthFormat,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, sampleCount,
+                    VULKAN_MEMORY_RENDER_TARGET);
+
+        colorBuffers[i] = (VulkanImage){0};
+        if (sampleCount != VK_SAMPLE_COUNT_1_BIT) {
+            createImage(context, &colorBuffers[i], swapchain.width, swapchain.height, swapchain.format,
+                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, sampleCount,
+                        VULKAN_MEMORY_RENDER_TARGET);
+        }
 
-        if (vkCreateQueryPool(context->device, &createInfo, NULL, &timestampQueryPools[i]) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to create query pools!\n");
-            exit(-1);
+        sceneColorBuffers[i] = (VulkanImage){0};
+        if (postProcessing) {
+            createImage(context, &sceneColorBuffers[i], swapchain.width, swapchain.height, swapchain.format,
+                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_SAMPLE_COUNT_1_BIT,
+                        VULKAN_MEMORY_RENDER_TARGET);
         }
     }
 
-    VkVertexInputAttributeDescription vertexAttributeDescriptions[3] = {0};
-    vertexAttributeDescriptions[0].binding = 0;
-    vertexAttributeDescriptions[0].location = 0;
-    vertexAttributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-    vertexAttributeDescriptions[0].offset = 0;
+    for (uint32_t i = 0; i < framebuffersCount; i++) {
+        uint32_t slot = postProcessing ? i : i / swapchain.imagesCount;
+        VkImageView target = postProcessing ? sceneColorBuffers[slot].view : swapchain.imageViews[i % swapchain.imagesCount];
 
-    vertexAttributeDescriptions[1].binding = 0;
-    vertexAttributeDescriptions[1].location = 1;
-    vertexAttributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    vertexAttributeDescriptions[1].offset = sizeof(float) * 2;
+        // color, depth, resolve (see createRenderPass)
+        VkImageView attachments[3];
+        uint32_t count = 0;
+        attachments[count++] = sampleCount != VK_SAMPLE_COUNT_1_BIT ? colorBuffers[slot].view : target;
+        attachments[count++] = depthBuffers[slot].view;
+        if (sampleCount != VK_SAMPLE_COUNT_1_BIT) attachments[count++] = target;
 
-    vertexAttributeDescriptions[2].binding = 0;
-    vertexAttributeDescriptions[2].location = 2;
-    vertexAttributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    vertexAttributeDescriptions[2].offset = sizeof(float) * 5;
+        framebuffers[i] = createFramebuffer(context, renderPass, count, attachments, swapchain.width, swapchain.height);
+    }
 
-    VkVertexInputBindingDescription vertexInputBinding = {0};
-    vertexInputBinding.binding = 0;
-    vertexInputBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-    vertexInputBinding.stride = sizeof(float) * 7;
+    for (uint32_t i = 0; i < postFramebuffersCount; i++) {
+        postFramebuffers[i] = createFramebuffer(context, postRenderPass, 1, &swapchain.imageViews[i],
+                                                swapchain.width, swapchain.height);
+    }
 
+    // not created yet during initApplication
+    if (settingsChanged && modelPipeline.pipeline) {
+        releasePipeline(context, &spritePipeline, retireValue);
+        for (uint32_t i = 0; i < modelVariantCount; i++) {
+            releasePipeline(context, &modelVariants[i].pipeline, retireValue);
+        }
+        releasePipeline(context, &postPipeline, retireValue);
+        createPipelines();
+    }
+}
 
-    spritePipeline = createPipeline(context, "/home/ttchef/coding/c/Vulkan-Hello-Triangle/shaders/texture_vert.spv",
-                                    "/home/ttchef/coding/c/Vulkan-Hello-Triangle/shaders/texture_frag.spv", renderPass,
-                                    swapchain.width, swapchain.height, vertexAttributeDescriptions,
-                                    ARRAY_COUNT(vertexAttributeDescriptions), &vertexInputBinding, 1,
-                                    &spriteDescriptorLayout, NULL);
+void recreateSwapchain() {
+    cpuProfilerBeginScope("recreate");
 
-    VkVertexInputAttributeDescription modelAttributeDescriptions[3] = {0};
-    modelAttributeDescriptions[0].binding = 0;
-    modelAttributeDescriptions[0].location = 0;
-    modelAttributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    modelAttributeDescriptions[0].offset = 0;
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    while (width == 0 || height == 0) {
+        glfwGetFramebufferSize(window, &width, &height);
+        glfwWaitEvents();
+    }
 
-    modelAttributeDescriptions[1].binding = 0;
-    modelAttributeDescriptions[1].location = 1;
-    modelAttributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    modelAttributeDescriptions[1].offset = sizeof(float) * 3;
+    VulkanSwapchain oldSwapchain = swapchain;
+    swapchain = createSwapchain(window, context, surface, swapchainUsage, presentMode, swapchainImageCount, &oldSwapchain);
 
-    modelAttributeDescriptions[2].binding = 0;
-    modelAttributeDescriptions[2].location = 2;
-    modelAttributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    modelAttributeDescriptions[2].offset = sizeof(float) * 6;
+    // There is no fence for presentation, so keep the old swapchain alive until the
+    // frames rendered to the new one finished as well, by then its presents are done.
+    deferDestroySwapchain(context, &oldSwapchain, context->graphicsQueue.timelineValue + framesInFlight);
 
-    VkVertexInputBindingDescription modelInputBinding = {0};
-    modelInputBinding.binding = 0;
-    modelInputBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-    modelInputBinding.stride = sizeof(float) * 8;
+    recreateRenderPass();
+    cpuProfilerEndScope();
+}
 
-    VkPushConstantRange pushConstant = {0};
-    pushConstant.offset = 0;
-    pushConstant.size = sizeof(HMM_Mat4);
-    pushConstant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+HMM_Mat4 getProjectionInverseZ(float fovy, float width, float height, float zNear) {
+    float f = 1.0f / tanf(fovy / 2.0f);
+    float aspect = width / height;
+    
+    HMM_Mat4 result = {0};
+    result.Elements[0][0] = f / aspect;
+    result.Elements[1][1] = -f;
+    result.Elements[2][3] = 1.0f;
+    result.Elements[3][2] = zNear;
+    return result;
+}
 
-    modelPipeline = createPipeline(context, "/home/ttchef/coding/c/Vulkan-Hello-Triangle/shaders/model_vert.spv",
-                                    "/home/ttchef/coding/c/Vulkan-Hello-Triangle/shaders/model_frag.spv", renderPass,
-                                   swapchain.width, swapchain.height, modelAttributeDescriptions, 
-                                   ARRAY_COUNT(modelAttributeDescriptions), &modelInputBinding, 1, &modelDescriptorLayout, 0);
+// Gpu time scales roughly with the pixel count, so the scale that would have hit the budget is
+// scale * sqrt(budget / time). Spikes are followed quickly, recovery is slow, and small deviations
+// are ignored so the resolution does not oscillate. The measured frame is framesInFlight old.
+static void updateRenderScale(double frameGpuTime) {
+    if (!dynamicResolution || frameGpuTime <= 0.0) return;
 
-    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++){
-        VkFenceCreateInfo createInfo = {0};
-        createInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        createInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    double budget = targetGpuTime * 0.9; // headroom for timing noise
+    double ratio = budget / frameGpuTime;
+    if (ratio > 0.95 && ratio < 1.05) return;
 
-        if (vkCreateFence(context->device, &createInfo, NULL, &fences[i]) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to create fence!\n");
-            return;
-        }
-    }
+    double desiredScale = renderScale * sqrt(ratio);
+    double gain = desiredScale < renderScale ? 0.5 : 0.05;
+    renderScale += (float)((desiredScale - renderScale) * gain);
 
-    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
-        VkSemaphoreCreateInfo createInfo = {0};
-        createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-        if (vkCreateSemaphore(context->device, &createInfo, NULL, &acrquireSemaphores[i]) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to create semaphore!\n");
-            exit(1);
-        }
-        if (vkCreateSemaphore(context->device, &createInfo, NULL, &releaseSemaphores[i]) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to create semaphore!\n");
-            exit(1);
-        }
+    if (renderScale < minRenderScale) renderScale = minRenderScale;
+    if (renderScale > 1.0f) renderScale = 1.0f;
+}
+
+// Part of the render targets the scene is rendered to this frame
+static VkExtent2D getSceneExtent() {
+    if (!postProcessing || !dynamicResolution) {
+        return (VkExtent2D){ swapchain.width, swapchain.height };
     }
 
-    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
-        VkCommandPoolCreateInfo createInfo = {0};
-        createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        createInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
-        createInfo.queueFamilyIndex = context->graphicsQueue.familyIndex;
+    VkExtent2D extent;
+    extent.width = (uint32_t)(swapchain.width * renderScale + 0.5f);
+    extent.height = (uint32_t)(swapchain.height * renderScale + 0.5f);
+    if (extent.width == 0) extent.width = 1;
+    if (extent.height == 0) extent.height = 1;
+    return extent;
+}
 
-        if (vkCreateCommandPool(context->device, &createInfo, NULL, &commandPools[i]) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to create Commandpool!\n");
-            return;
-        }
+// Collects the gpu scopes of the frame that last used this slot and updates the
+// gpu time and latency estimates. Only valid after the slot's timeline value was waited on.
+static void readFrameTimings(uint32_t slot) {
+    FrameTiming* timing = &frameTimings[slot];
+    if (!gpuProfilerCollect(&gpuProfiler, slot, &traceWriter)) return;
+
+    double frameGpuTime = gpuProfiler.frameTimeMs;
+    if (bench.enabled) {
+        benchRecordGpuTime(&bench, timing->benchFrame, frameGpuTime);
+    }
+    gpuFrameTimeAvg = gpuFrameTimeAvg * 0.95 + frameGpuTime * 0.05;
+    updateRenderScale(frameGpuTime);
+#ifdef LOG_GPU_TIME
+    printf("Gpu Frametime: %lf ms\n", gpuFrameTimeAvg);
+    for (uint32_t i = 0; i < gpuProfiler.resultCount; i++) {
+        GpuProfilerResult* scope = &gpuProfiler.results[i];
+        printf("%*s%s: %.3lf ms\n", (int)(scope->depth + 1) * 2, "", scope->name, scope->durationMs);
     }
+#endif
 
-    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
-    
-        VkCommandBufferAllocateInfo allocInfo = {0};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = 1;
-        allocInfo.commandPool = commandPools[i];
+    // input -> submit, waiting behind the previous frame, then our own gpu work.
+    // Scanout after the gpu finished is not visible to us and not included.
+    double latency = (timing->submitTime - timing->inputTime + timing->queueDelay) * 1000.0 + frameGpuTime;
+    latencyAvg = latencyAvg * 0.95 + latency * 0.05;
+}
 
-        if (vkAllocateCommandBuffers(context->device, &allocInfo, &commandBuffers[i]) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to create commandbuffer!\n");
-            return;
-        }
+static void handleCapture(VulkanReadbackSlot* slot) {
+    captureDone = true;
+    if (!bench.enabled) {
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
     }
 
-    createBuffer(context, &spriteVertexBuffer, sizeof(vertexData), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-                 VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    uploadDataToBuffer(context, &spriteVertexBuffer, vertexData, sizeof(vertexData));
-
+    uint8_t* pixels = malloc((size_t)slot->width * slot->height * 4);
+    if (!pixels) {
+        fprintf(stderr, "Failed to allocate capture pixels!\n");
+        goldenFailed = goldenPath != NULL;
+        return;
+    }
+    if (!readbackToRgba8(slot, pixels)) {
+        goldenFailed = goldenPath != NULL;
+        free(pixels);
+        return;
+    }
 
-    createBuffer(context, &spriteIndexBuffer, sizeof(indexData), VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-                 VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    uploadDataToBuffer(context, &spriteIndexBuffer, indexData, sizeof(indexData));
+    if (captureOutputPath && writePng(captureOutputPath, pixels, slot->width, slot->height)) {
+        printf("Captured frame %lu to %s\n", slot->tag, captureOutputPath);
+    }
 
-    // Camera
-    {
-        camera.cameraPosition = HMM_V3(0.0f, 0.0f, 0.0f);
-        camera.cameraDirection = HMM_V3(0.0f, 0.0f, 1.0f);
+    if (goldenPath) {
+        GoldenResult golden = compareWithGolden(goldenPath, pixels, slot->width, slot->height, goldenTolerance, goldenDiffPath);
+        double mismatch = golden.compared ? (double)golden.mismatchedPixels / golden.totalPixels : 1.0;
+        goldenFailed = !golden.compared || mismatch > goldenMaxMismatch;
+        printf("Golden image %s: %s, %u of %u pixels differ by more than %u (max %u, mean %.3lf)\n",
+               goldenPath, goldenFailed ? "FAILED" : "passed", golden.mismatchedPixels, golden.totalPixels,
+               goldenTolerance, golden.maxDifference, golden.meanDifference);
+    }
+    free(pixels);
+}
 
-        camera.up = HMM_V3(0.0f, 1.0f, 0.0f);
-        camera.yaw = 0.0f;
-        camera.pitch = 0.0f;
+// Hands finished readbacks to the capture, never waits for the gpu
+static void processReadbacks() {
+    VulkanReadbackSlot* slot;
+    while ((slot = pollReadback(context, &readbackRing))) {
+        handleCapture(slot);
+        releaseReadback(slot);
     }
 }
 
-void recreateRenderPass() {
-    if (!framebuffers) {
-        framebuffers = malloc(sizeof(VkFramebuffer) * swapchain.imagesCount);
-        if (!framebuffers) {
-            fprintf(stderr, "Failed to allocate framebuffers!\n");
-            exit(-1);
-        }
+// Everything the frame's command buffer referenced retires with its submission
+static void markFrameResourcesUsed(uint64_t submitValue) {
+    if (drawSprite) {
+        getBuffer(context, spriteVertexBuffer)->lastUse = submitValue;
+        getBuffer(context, spriteIndexBuffer)->lastUse = submitValue;
+        getImage(context, image)->lastUse = submitValue;
+    }
+    else {
+        frameAllocator.buffer.lastUse = submitValue;
+        if (useBindless) bindless.materialBuffer.lastUse = submitValue;
+        getBuffer(context, model.vertexBuffer)->lastUse = submitValue;
+        getBuffer(context, model.indexBuffer)->lastUse = submitValue;
+        getImage(context, model.albedoTexture)->lastUse = submitValue;
     }
+    depthBuffers[frameIndex].lastUse = submitValue;
+    if (colorBuffers[frameIndex].image) colorBuffers[frameIndex].lastUse = submitValue;
+    if (postProcessing) sceneColorBuffers[frameIndex].lastUse = submitValue;
+}
 
-    if (!depthBuffers) {
-        depthBuffers = malloc(sizeof(VulkanImage) * swapchain.imagesCount);
-        if (!depthBuffers) {
-            fprintf(stderr, "Failed to allocate depthBuffers!\n");
-            exit(-1);
-        }
+// Waits for the frame slot and acquires the next swapchain image.
+// Returns false if the swapchain had to be recreated and the frame should be skipped.
+bool beginFrame() {
+    if (pendingFramesInFlight) {
+        setFramesInFlight(pendingFramesInFlight);
+        pendingFramesInFlight = 0;
     }
 
-    if (!colorBuffers) {
-        colorBuffers = malloc(sizeof(VulkanImage) * swapchain.imagesCount);
-        if (!colorBuffers) {
-            fprintf(stderr, "Failed to allocate colorBuffers!\n");
-            exit(-1);
-        }
+    // waits only for the submission that last used this slot's command pool and uniform buffer
+    cpuProfilerBeginScope("wait");
+    bool waited = waitForTimelineValue(context, &context->graphicsQueue, frameTimelineValues[frameIndex], UINT64_MAX);
+    cpuProfilerEndScope();
+    if (!waited) {
+        return false;
     }
 
-    if (renderPass) {
-        destroyRenderPass(context, renderPass);
+    readFrameTimings(frameIndex);
+    processReadbacks();
+    flushDeletionQueue(context);
 
-        for (uint32_t i = 0; i < swapchain.imagesCount; i++) {
-            vkDestroyFramebuffer(context->device, framebuffers[i], NULL);
-            destroyImage(context, &depthBuffers[i]);
-            destroyImage(context, &colorBuffers[i]);
-        }
+    if (renderSettingsChanged) {
+        renderSettingsChanged = false;
+        recreateRenderPass();
+    }
+
+    // getting image from swapchain
+    cpuProfilerBeginScope("acquire");
+    VkResult result = vkAcquireNextImageKHR(context->device, swapchain.swapchain, UINT64_MAX, acrquireSemaphores[frameIndex], 0, &imageIndex);
+    cpuProfilerEndScope();
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        recreateSwapchain();
+        return false;
     }
+    // on VK_SUBOPTIMAL_KHR the acquire semaphore is signaled, so the frame is still
+    // rendered and the swapchain recreated after present
+    else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        fprintf(stderr, "Failed to acrquire next image from swapchain!\n");
+        return false;
+    }
+
+    return true;
+}
+
+static void sleepSeconds(double seconds) {
+    struct timespec duration;
+    duration.tv_sec = (time_t)seconds;
+    duration.tv_nsec = (long)((seconds - (double)duration.tv_sec) * 1e9);
+    nanosleep(&duration, NULL);
+}
 
-    framebuffers = realloc(framebuffers, sizeof(VkFramebuffer) * swapchain.imagesCount);
-    if (!framebuffers) {
-        fprintf(stderr, "Failed to reallocate framebuffers!\n");
-        exit(-1);
+// Predicts when the previously submitted frame finishes on the gpu and sleeps
+// until just enough time is left to sample input and record before that.
+void waitForFrameStart() {
+    const double safetyMargin = 0.0005;
+    double predictedGpuIdle = lastSubmitTime + gpuFrameTimeAvg * 1e-3;
+    double frameStart = predictedGpuIdle - cpuRecordTimeAvg * 1e-3 - safetyMargin;
+
+    double now = glfwGetTime();
+    if (frameStart > now) {
+        cpuProfilerBeginScope("sleep");
+        sleepSeconds(frameStart - now);
+        cpuProfilerEndScope();
     }
+}
 
-    depthBuffers = realloc(depthBuffers, sizeof(VulkanImage) * swapchain.imagesCount);
-    if (!depthBuffers){
-        fprintf(stderr, "Failed to reallocate depthBuffer!\n");
-        exit(-1);
+// Starts rendering the scene: into the MSAA attachments of the frame slot with a resolve, or
+// single sampled straight into the target. The target is the swapchain image or, with post
+// processing, the slot's scene color buffer.
+static void beginSceneRendering(VkCommandBuffer commandBuffer, VkClearValue* clearValues, VkExtent2D extent) {
+    if (!useDynamicRendering) {
+        VkRenderPassBeginInfo beginInfo = {0};
+        beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        beginInfo.renderPass = renderPass;
+        beginInfo.framebuffer = framebuffers[postProcessing ? frameIndex : frameIndex * swapchain.imagesCount + imageIndex];
+        beginInfo.renderArea = (VkRect2D){ (VkOffset2D){0, 0}, extent };
+        beginInfo.clearValueCount = 2;
+        beginInfo.pClearValues = clearValues;
+            
+        vkCmdBeginRenderPass(commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        return;
     }
 
-    colorBuffers = realloc(colorBuffers, sizeof(VulkanImage) * swapchain.imagesCount);
-    if (!colorBuffers) {
-        fprintf(stderr, "Failed to reallocate colorBuffers!\n");
-        exit(-1);
+    bool resolve = sampleCount != VK_SAMPLE_COUNT_1_BIT;
+    VkImage targetImage = postProcessing ? sceneColorBuffers[frameIndex].image : swapchain.images[imageIndex];
+    VkImageView targetView = postProcessing ? sceneColorBuffers[frameIndex].view : swapchain.imageViews[imageIndex];
+
+    // What the render pass did implicitly: previous contents are cleared anyway, so every
+    // image starts from UNDEFINED, but the previous frame's writes still have to be ordered
+    if (resolve) {
+        cmdTransitionImage(commandBuffer, colorBuffers[frameIndex].image, VK_IMAGE_ASPECT_COLOR_BIT,
+                           VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                           VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                           VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
     }
+    cmdTransitionImage(commandBuffer, depthBuffers[frameIndex].image, getImageAspect(depthFormat),
+                       VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+    // the acquire semaphore is waited on at COLOR_ATTACHMENT_OUTPUT, a scene color buffer
+    // was last read by the fragment shader of the post pass
+    cmdTransitionImage(commandBuffer, targetImage, VK_IMAGE_ASPECT_COLOR_BIT,
+                       VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+
+    VkRenderingAttachmentInfoKHR colorAttachment = {0};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    colorAttachment.imageView = resolve ? colorBuffers[frameIndex].view : targetView;
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.resolveMode = resolve ? VK_RESOLVE_MODE_AVERAGE_BIT : VK_RESOLVE_MODE_NONE;
+    colorAttachment.resolveImageView = resolve ? targetView : VK_NULL_HANDLE;
+    colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = resolve ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE; // only the resolve is needed
+    colorAttachment.clearValue = clearValues[0];
+
+    VkRenderingAttachmentInfoKHR depthAttachment = {0};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    depthAttachment.imageView = depthBuffers[frameIndex].view;
+    depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.clearValue = clearValues[1];
+
+    VkRenderingInfoKHR renderingInfo = {0};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    renderingInfo.renderArea = (VkRect2D){ (VkOffset2D){0, 0}, extent };
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    renderingInfo.pDepthAttachment = &depthAttachment;
+
+    context->cmdBeginRendering(commandBuffer, &renderingInfo);
+}
 
-    renderPass = createRenderPass(context, swapchain.format, VK_SAMPLE_COUNT_4_BIT);
+static void endSceneRendering(VkCommandBuffer commandBuffer) {
+    if (!useDynamicRendering) {
+        vkCmdEndRenderPass(commandBuffer);
+        return;
+    }
 
-    for (uint32_t i = 0; i < swapchain.imagesCount; i++) {
-        createImage(context, &depthBuffers[i], swapchain.width, swapchain.height, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_SAMPLE_COUNT_4_BIT);
-        createImage(context, &colorBuffers[i], swapchain.width, swapchain.height, swapchain.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_SAMPLE_COUNT_4_BIT);
+    context->cmdEndRendering(commandBuffer);
 
-        VkImageView attachments[] = {
-            colorBuffers[i].view,
-            depthBuffers[i].view,
-            swapchain.imageViews[i],
-        };
+    if (postProcessing) {
+        cmdTransitionImage(commandBuffer, sceneColorBuffers[frameIndex].image, VK_IMAGE_ASPECT_COLOR_BIT,
+                           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                           VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                           VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+        return;
+    }
 
-        VkFramebufferCreateInfo createInfo = {0};
-        createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        createInfo.renderPass = renderPass;
-        createInfo.attachmentCount = ARRAY_COUNT(attachments);
-        createInfo.pAttachments = attachments;
-        createInfo.width = swapchain.width;
-        createInfo.height = swapchain.height;
-        createInfo.layers = 1;
-
-        if (vkCreateFramebuffer(context->device, &createInfo, NULL, &framebuffers[i]) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to create vulkan framebuffers!\n");
-            return;
-        }
-    }   
+    // the resolve writes in COLOR_ATTACHMENT_OUTPUT, present waits on the release semaphore
+    cmdTransitionImage(commandBuffer, swapchain.images[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT,
+                       VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
 }
 
-void recreateSwapchain() {
-
-    int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
-    while (width == 0 || height == 0) {
-        glfwGetFramebufferSize(window, &width, &height);
-        glfwWaitEvents();
-    }
+// Filters (and upscales) the slot's scene color into the swapchain image with a fullscreen triangle
+static void renderPostProcessing(VkCommandBuffer commandBuffer, VkExtent2D sceneExtent) {
+    if (!useDynamicRendering) {
+        VkClearValue clearValue = { .color = { {0.0f, 0.0f, 0.0f, 1.0f} } };
 
-    vkDeviceWaitIdle(context->device);
+        VkRenderPassBeginInfo beginInfo = {0};
+        beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        beginInfo.renderPass = postRenderPass;
+        beginInfo.framebuffer = postFramebuffers[imageIndex];
+        beginInfo.renderArea = (VkRect2D){ (VkOffset2D){0, 0}, (VkExtent2D){swapchain.width, swapchain.height}};
+        beginInfo.clearValueCount = 1;
+        beginInfo.pClearValues = &clearValue;
 
-    VulkanSwapchain oldSwapchain = swapchain;
-    swapchain = createSwapchain(window, context, surface, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &oldSwapchain);
+        vkCmdBeginRenderPass(commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    }
+    else {
+        cmdTransitionImage(commandBuffer, swapchain.images[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT,
+                           VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                           VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+                           VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+
+        VkRenderingAttachmentInfoKHR colorAttachment = {0};
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        colorAttachment.imageView = swapchain.imageViews[imageIndex];
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; // every pixel is written
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+        VkRenderingInfoKHR renderingInfo = {0};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+        renderingInfo.renderArea = (VkRect2D){ (VkOffset2D){0, 0}, (VkExtent2D){swapchain.width, swapchain.height}};
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+
+        context->cmdBeginRendering(commandBuffer, &renderingInfo);
+    }
 
-    destroySwapchain(context, &oldSwapchain);
+    VkViewport viewport = (VkViewport){0.0f, 0.0f, (float)swapchain.width, (float)swapchain.height, 0.0f, 1.0f};
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor = (VkRect2D){{0, 0}, {swapchain.width, swapchain.height}};
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    PostParams params = {0};
+    params.uvScale = HMM_V2((float)sceneExtent.width / (float)swapchain.width, (float)sceneExtent.height / (float)swapchain.height);
+    params.texelSize = HMM_V2(1.0f / (float)swapchain.width, 1.0f / (float)swapchain.height);
+    params.sharpness = sharpness;
+
+    // written every frame, so the scene color buffers can be recreated without touching sets in use
+    VkDescriptorSet postDescriptorSet = allocateDescriptorSet(context, &frameDescriptorAllocators[frameIndex], postDescriptorLayout);
+    if (postDescriptorSet) {
+        VulkanDescriptorInfo info = {0};
+        info.image.sampler = postSampler;
+        info.image.imageView = sceneColorBuffers[frameIndex].view;
+        info.image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        vkUpdateDescriptorSetWithTemplate(context->device, postDescriptorSet, postUpdateTemplate, &info);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, postPipeline.pipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, postPipeline.layout, 0, 1, &postDescriptorSet, 0, NULL);
+        vkCmdPushConstants(commandBuffer, postPipeline.layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(params), &params);
+        vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    }
 
-    recreateRenderPass();
-}
+    if (!useDynamicRendering) {
+        vkCmdEndRenderPass(commandBuffer);
+        return;
+    }
 
-HMM_Mat4 getProjectionInverseZ(float fovy, float width, float height, float zNear) {
-    float f = 1.0f / tanf(fovy / 2.0f);
-    float aspect = width / height;
-    
-    HMM_Mat4 result = {0};
-    result.Elements[0][0] = f / aspect;
-    result.Elements[1][1] = -f;
-    result.Elements[2][3] = 1.0f;
-    result.Elements[3][2] = zNear;
-    return result;
+    context->cmdEndRendering(commandBuffer);
+    cmdTransitionImage(commandBuffer, swapchain.images[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT,
+                       VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
 }
 
 void renderApplication() {
 
-    static double frameGpuAvg = 0.0;
     static float greenChannel = 0.0f;
-    greenChannel = (sin(glfwGetTime()) + 1) / 2;
+    greenChannel = (sin(sceneTime) + 1) / 2;
     if (greenChannel > 1.0f) greenChannel = 0.0f;
 
-    uint32_t imageIndex = 0;
-
-    if (vkWaitForFences(context->device, 1, &fences[frameIndex], VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to wait for fences!\n");
-        return;
-    }
-
-    // getting image from swapchain
-    VkResult result = vkAcquireNextImageKHR(context->device, swapchain.swapchain, UINT64_MAX, acrquireSemaphores[frameIndex], 0, &imageIndex);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
-        framebufferResized = false;
-        recreateSwapchain();
-        return;
-    }
-    else if (result != VK_SUCCESS) {
-        fprintf(stderr, "Failed to acrquire next image from swapchain!\n");
-        return;
-    }
-
-    if (vkResetFences(context->device, 1, &fences[frameIndex]) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to reset fences!\n");
-        return;
-    }
-
-    // Query timestamps 
-#ifdef LOG_GPU_TIME
-    uint64_t timestamps[2] = {0, 0};
-    VkResult timestampsValid = vkGetQueryPoolResults(context->device, timestampQueryPools[frameIndex], 0, ARRAY_COUNT(timestamps),
-                                                     sizeof(timestamps), timestamps, sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT);
-    if (timestampsValid == VK_SUCCESS) {
-        double frameGpuBegin = (double)timestamps[0] * context->physicalDeviceProperties.limits.timestampPeriod * 1e-6; // mul with 1e-6 to convert to ms
-        double frameGpuEnd = (double)timestamps[1] * context->physicalDeviceProperties.limits.timestampPeriod * 1e-6;
-        double frameGpuTime = frameGpuEnd - frameGpuBegin;
-        frameGpuAvg = frameGpuAvg * 0.95 + frameGpuTime * 0.05;
-        printf("Gpu Frametime: %lf ms\n", frameGpuAvg);
-    }
-#endif
+    cpuProfilerBeginScope("record");
 
     // reset command pool
     if (vkResetCommandPool(context->device, commandPools[frameIndex], 0) != VK_SUCCESS) {
         fprintf(stderr, "Failed to reset commandpool!\n");
+        cpuProfilerEndScope();
         return;
     }
+    // the slot's previous frame finished like its command pool, its region and sets can be overwritten
+    beginFrameAllocator(&frameAllocator, frameIndex);
+    resetDescriptorAllocator(context, &frameDescriptorAllocators[frameIndex]);
 
     VkCommandBufferBeginInfo beginInfo = {0};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -676,6 +1425,7 @@ void renderApplication() {
 
     if (vkBeginCommandBuffer(commandBuffers[frameIndex], &beginInfo) != VK_SUCCESS) {
         fprintf(stderr, "Failed to begin commandbuffer!\n");
+        cpuProfilerEndScope();
         return;
     }
 
@@ -683,92 +1433,139 @@ void renderApplication() {
     {
         VkCommandBuffer commandBuffer = commandBuffers[frameIndex];
 
-        vkCmdResetQueryPool(commandBuffer, timestampQueryPools[frameIndex], 0, 64); // <- minecraft stack
-        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, timestampQueryPools[frameIndex], 0);
+        gpuProfilerBeginFrame(&gpuProfiler, frameIndex, commandBuffer);
+        gpuProfilerBeginScope(&gpuProfiler, commandBuffer, "frame");
+        gpuProfilerBeginScope(&gpuProfiler, commandBuffer, "scene");
 
         VkClearValue clearValues[2] = {
             { .color = { {1.0f, greenChannel, 1.0f, 1.0f} } },
             { .depthStencil = { 0.0f, 0 } }
         };
 
-        VkRenderPassBeginInfo beginInfo = {0};
-        beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        beginInfo.renderPass = renderPass;
-        beginInfo.framebuffer = framebuffers[imageIndex];
-        beginInfo.renderArea = (VkRect2D){ (VkOffset2D){0, 0}, (VkExtent2D){swapchain.width, swapchain.height}};
-        beginInfo.clearValueCount = ARRAY_COUNT(clearValues);
-        beginInfo.pClearValues = clearValues;
-            
-        vkCmdBeginRenderPass(commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        VkExtent2D sceneExtent = getSceneExtent();
+        beginSceneRendering(commandBuffer, clearValues, sceneExtent);
 
-        VkViewport viewport = (VkViewport){0.0f, 0.0f, (float)swapchain.width, (float)swapchain.height, 0.0f, 1.0f};
+        VkViewport viewport = (VkViewport){0.0f, 0.0f, (float)sceneExtent.width, (float)sceneExtent.height, 0.0f, 1.0f};
         vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-        VkRect2D scissor = (VkRect2D){{0, 0}, {swapchain.width, swapchain.height}};
+        VkRect2D scissor = (VkRect2D){{0, 0}, sceneExtent};
         vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-#ifndef USE_MODEL_PIPELINE
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, spritePipeline.pipeline);
+        if (drawSprite) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, spritePipeline.pipeline);
 
-        VkDeviceSize offset = 0;
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &spriteVertexBuffer.buffer, &offset);
-        vkCmdBindIndexBuffer(commandBuffer, spriteIndexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, spritePipeline.layout, 0, 1, &spriteDescriptorSet, 0, 0);
-
-        vkCmdDrawIndexed(commandBuffer, ARRAY_COUNT(indexData), 1, 0, 0, 0);
-#else 
-        HMM_Mat4 translationMatrix = HMM_Translate(HMM_V3(0.0f, 0.0f, 3.0f));
-        HMM_Mat4 scaleMatrix = HMM_Scale(HMM_V3(100.0f, 100.0f, 100.0f));
-        HMM_Mat4 rotatationMatrix = HMM_Rotate_LH(greenChannel * 10.0f, HMM_V3(0.0f, 1.0f, 0.0f));
+            VkBuffer vertexBuffer = getBuffer(context, spriteVertexBuffer)->buffer;
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+            vkCmdBindIndexBuffer(commandBuffer, getBuffer(context, spriteIndexBuffer)->buffer, 0, VK_INDEX_TYPE_UINT32);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, spritePipeline.layout, 0, 1, &spriteDescriptorSet, 0, 0);
 
+            vkCmdDrawIndexed(commandBuffer, ARRAY_COUNT(indexData), 1, 0, 0, 0);
+        }
+        else {
+            HMM_Mat4 translationMatrix = HMM_Translate(HMM_V3(0.0f, 0.0f, 3.0f));
+            HMM_Mat4 scaleMatrix = HMM_Scale(HMM_V3(100.0f, 100.0f, 100.0f));
+            HMM_Mat4 rotatationMatrix = HMM_Rotate_LH(greenChannel * 10.0f, HMM_V3(0.0f, 1.0f, 0.0f));
 
-        HMM_Mat4 tempModel = HMM_MulM4(translationMatrix, scaleMatrix);
-        HMM_Mat4 modelMatrix = HMM_MulM4(tempModel, rotatationMatrix);
 
-        HMM_Mat4 projMatrix = getProjectionInverseZ(degToRad(80.0f), swapchain.width, swapchain.height, 0.01);
+            HMM_Mat4 tempModel = HMM_MulM4(translationMatrix, scaleMatrix);
+            HMM_Mat4 modelMatrix = HMM_MulM4(tempModel, rotatationMatrix);
 
-        HMM_Mat4 modelView = HMM_MulM4(camera.view, modelMatrix);
-        HMM_Mat4 modelViewProj = HMM_MulM4(camera.viewProj, modelMatrix);
+            HMM_Mat4 projMatrix = getProjectionInverseZ(degToRad(80.0f), swapchain.width, swapchain.height, 0.01);
 
-        void* mapped;
-        vkMapMemory(context->device, modelUniformBuffers[frameIndex].memory, 0, sizeof(HMM_Mat4) * 2, 0, &mapped);
-        memcpy(mapped, &modelViewProj, sizeof(modelViewProj));
-        memcpy((uint8_t*)mapped + sizeof(HMM_Mat4), &modelView, sizeof(modelView));
-        vkUnmapMemory(context->device, modelUniformBuffers[frameIndex].memory);
+            sceneSetLocal(&scene, modelNode, &modelMatrix);
+            if (sceneStressRoot != SCENE_INVALID_NODE) {
+                HMM_Mat4 spin = HMM_Rotate_LH((float)sceneTime, HMM_V3(0.0f, 1.0f, 0.0f));
+                sceneSetLocal(&scene, sceneStressRoot, &spin);
+            }
 
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, modelPipeline.pipeline);
+            cpuProfilerBeginScope("scene");
+            updateScene(&scene, &camera.view, &camera.viewProj);
+            cpuProfilerEndScope();
+
+            ModelTransforms transforms;
+            transforms.modelViewProj = *sceneGetModelViewProj(&scene, modelNode);
+            transforms.modelView = *sceneGetModelView(&scene, modelNode);
+            transforms.normalMatrix = *sceneGetNormalMatrix(&scene, modelNode);
+
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, modelPipeline.pipeline);
+
+            VkBuffer vertexBuffer = getBuffer(context, model.vertexBuffer)->buffer;
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+            vkCmdBindIndexBuffer(commandBuffer, getBuffer(context, model.indexBuffer)->buffer, 0, VK_INDEX_TYPE_UINT16);
+            // set 0 stays bound for every draw using the bindless layout. With push constants the model
+            // set is bound once too (its uniform buffer is unused), per draw only the transforms change.
+            if (useBindless) {
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, modelPipeline.layout, 0, 1, &bindless.set, 0, NULL);
+            }
+            if (modelPipeline.drawData.pushConstants) {
+                uint32_t unusedOffset = 0;
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, modelPipeline.layout, modelPipeline.drawData.set,
+                                        1, &modelDescriptorSet, 1, &unusedOffset);
+            }
 
-        VkDeviceSize offset = 0;
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &model.vertexBuffer.buffer, &offset);
-        vkCmdBindIndexBuffer(commandBuffer, model.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, modelPipeline.layout, 0, 1, &modelDescriptorSets[frameIndex], 0, NULL);
-        vkCmdDrawIndexed(commandBuffer, model.numIndices, 1, 0, 0, 0);
+            if (cmdSetDrawData(commandBuffer, &modelPipeline, &frameAllocator, modelDescriptorSet, &transforms)) {
+                vkCmdDrawIndexed(commandBuffer, model.numIndices, 1, 0, 0, useBindless ? modelMaterial : 0);
+            }
+        }
+        endSceneRendering(commandBuffer);
+        gpuProfilerEndScope(&gpuProfiler, commandBuffer);
 
-#endif
-        vkCmdEndRenderPass(commandBuffer);
+        if (postProcessing) {
+            gpuProfilerBeginScope(&gpuProfiler, commandBuffer, fxaaEnabled ? "fxaa" : "upscale");
+            renderPostProcessing(commandBuffer, sceneExtent);
+            gpuProfilerEndScope(&gpuProfiler, commandBuffer);
+        }
 
-        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, timestampQueryPools[frameIndex], 1);
+        gpuProfilerEndScope(&gpuProfiler, commandBuffer);
+        gpuProfilerEndFrame(&gpuProfiler);
+
+        // after the profiled scopes, the copy is not part of the frame's gpu time. A recreated
+        // swapchain could have lost the transfer usage, the frame is then reported as not captured.
+        if ((int64_t)renderedFrames == captureFrame && (swapchain.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+            pendingReadback = cmdReadbackImage(context, &readbackRing, commandBuffer, swapchain.images[imageIndex],
+                                               VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, swapchain.format,
+                                               swapchain.width, swapchain.height, renderedFrames);
+            if (!pendingReadback) {
+                fprintf(stderr, "Failed to capture frame %lu!\n", renderedFrames);
+            }
+        }
     }
 
-    if (vkEndCommandBuffer(commandBuffers[frameIndex]) != VK_SUCCESS) {
+    VkResult recordResult = vkEndCommandBuffer(commandBuffers[frameIndex]);
+    cpuProfilerEndScope();
+    if (recordResult != VK_SUCCESS) {
         fprintf(stderr, "Failed to record commandbuffer!\n");
         return;
     }
 
-    // send to graphicsQueue
-    VkSubmitInfo submitInfo = {0};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffers[frameIndex];
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &acrquireSemaphores[frameIndex];
-
-    VkPipelineStageFlags waitMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-
-    submitInfo.pWaitDstStageMask = &waitMask;
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &releaseSemaphores[frameIndex];
-    vkQueueSubmit(context->graphicsQueue.queue, 1, &submitInfo, fences[frameIndex]);
+    // send to graphicsQueue, the binary semaphores are only for the swapchain
+    cpuProfilerBeginScope("submit");
+    uint64_t submitValue = submitToQueue(context, &context->graphicsQueue, commandBuffers[frameIndex],
+                                         acrquireSemaphores[frameIndex], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                         releaseSemaphores[frameIndex]);
+    cpuProfilerEndScope();
+    if (!submitValue) {
+        return;
+    }
+    frameTimelineValues[frameIndex] = submitValue;
+    if (pendingReadback) {
+        pendingReadback->readyValue = submitValue;
+        pendingReadback = NULL;
+    }
+    renderedFrames++;
+    markFrameResourcesUsed(submitValue);
+
+    double submitTime = glfwGetTime();
+    FrameTiming* timing = &frameTimings[frameIndex];
+    timing->inputTime = lastInputTime;
+    timing->submitTime = submitTime;
+    timing->benchFrame = bench.frame;
+    timing->queueDelay = lastSubmitTime + gpuFrameTimeAvg * 1e-3 - submitTime;
+    if (timing->queueDelay < 0.0) timing->queueDelay = 0.0;
+    cpuRecordTimeAvg = cpuRecordTimeAvg * 0.95 + (submitTime - lastInputTime) * 1000.0 * 0.05;
+    lastSubmitTime = submitTime;
 
     VkPresentInfoKHR presentInfo = {0};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -778,9 +1575,12 @@ void renderApplication() {
     presentInfo.waitSemaphoreCount = 1;
     presentInfo.pWaitSemaphores = &releaseSemaphores[frameIndex];
 
-    result = vkQueuePresentKHR(context->graphicsQueue.queue, &presentInfo);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
+    cpuProfilerBeginScope("present");
+    VkResult result = vkQueuePresentKHR(context->graphicsQueue.queue, &presentInfo);
+    cpuProfilerEndScope();
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized || swapchainSettingsChanged) {
         framebufferResized = false;
+        swapchainSettingsChanged = false;
         recreateSwapchain();
     }
     else if (result != VK_SUCCESS) {
@@ -788,65 +1588,164 @@ void renderApplication() {
     }
 
 
-    frameIndex = (frameIndex + 1) % FRAMES_IN_FLIGHT;
+    frameIndex = (frameIndex + 1) % framesInFlight;
 }
 
-void shutdownApplication() {
-    vkDeviceWaitIdle(context->device);
+// Writes setCount sets of a typical material layout (uniform buffer + two textures) with
+// vkUpdateDescriptorSets and with an update template and prints the cpu time per set.
+static void runDescriptorBenchmark(uint32_t setCount) {
+    const uint32_t rounds = 10;
 
-    // Query Pool 
-    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
-        vkDestroyQueryPool(context->device, timestampQueryPools[i], NULL);
+    VkDescriptorSetLayoutBinding bindings[] = {
+        { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, 0 },
+        { 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, 0 },
+        { 2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, 0 },
+    };
+    VkDescriptorSetLayout layout = getDescriptorSetLayout(context, bindings, ARRAY_COUNT(bindings));
+    VkDescriptorUpdateTemplate updateTemplate = getDescriptorUpdateTemplate(context, layout);
+    if (!layout || !updateTemplate) return;
+
+    VulkanDescriptorAllocator allocator = {0};
+    VkDescriptorSet* sets = malloc(sizeof(VkDescriptorSet) * setCount);
+    if (!sets) {
+        fprintf(stderr, "Failed to allocate descriptor benchmark sets!\n");
+        return;
     }
-
-    vkDestroyDescriptorPool(context->device, modelDescriptorPool, NULL);
-    vkDestroyDescriptorSetLayout(context->device, modelDescriptorLayout, NULL);
-    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
-        destroyBuffer(context, &modelUniformBuffers[i]);
+    for (uint32_t i = 0; i < setCount; i++) {
+        sets[i] = allocateDescriptorSet(context, &allocator, layout);
+        if (!sets[i]) {
+            free(sets);
+            destroyDescriptorAllocator(context, &allocator);
+            return;
+        }
     }
-    destroyModel(context, &model);
 
-    vkDestroyDescriptorPool(context->device, spriteDescriptorPool, NULL);
-    vkDestroyDescriptorSetLayout(context->device, spriteDescriptorLayout, NULL);
+    // every set points at different transforms, like per draw sets would
+    uint32_t offsetCount = (uint32_t)(frameAllocator.frameSize / frameAllocator.alignment);
+
+    uint64_t bestWrites = UINT64_MAX;
+    uint64_t bestTemplate = UINT64_MAX;
+    for (uint32_t round = 0; round < rounds; round++) {
+        uint64_t start = traceNowNs();
+        for (uint32_t i = 0; i < setCount; i++) {
+            VkDescriptorBufferInfo bufferInfo = {0};
+            bufferInfo.buffer = frameAllocator.buffer.buffer;
+            bufferInfo.offset = (i % offsetCount) * frameAllocator.alignment;
+            bufferInfo.range = sizeof(ModelTransforms);
+
+            VkDescriptorImageInfo imageInfos[2] = {0};
+            for (uint32_t j = 0; j < 2; j++) {
+                imageInfos[j].sampler = sampler;
+                imageInfos[j].imageView = getImage(context, model.albedoTexture)->view;
+                imageInfos[j].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            }
+
+            VkWriteDescriptorSet descriptorWrites[3];
+            descriptorWrites[0] = (VkWriteDescriptorSet){0};
+            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[0].dstSet = sets[i];
+            descriptorWrites[0].dstBinding = 0;
+            descriptorWrites[0].descriptorCount = 1;
+            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            descriptorWrites[0].pBufferInfo = &bufferInfo;
+            for (uint32_t j = 0; j < 2; j++) {
+                descriptorWrites[j + 1] = (VkWriteDescriptorSet){0};
+                descriptorWrites[j + 1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[j + 1].dstSet = sets[i];
+                descriptorWrites[j + 1].dstBinding = j + 1;
+                descriptorWrites[j + 1].descriptorCount = 1;
+                descriptorWrites[j + 1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                descriptorWrites[j + 1].pImageInfo = &imageInfos[j];
+            }
+            vkUpdateDescriptorSets(context->device, ARRAY_COUNT(descriptorWrites), descriptorWrites, 0, NULL);
+        }
+        uint64_t writes = traceNowNs() - start;
+        if (writes < bestWrites) bestWrites = writes;
+
+        start = traceNowNs();
+        for (uint32_t i = 0; i < setCount; i++) {
+            VulkanDescriptorInfo infos[3];
+            infos[0].buffer.buffer = frameAllocator.buffer.buffer;
+            infos[0].buffer.offset = (i % offsetCount) * frameAllocator.alignment;
+            infos[0].buffer.range = sizeof(ModelTransforms);
+            for (uint32_t j = 1; j < 3; j++) {
+                infos[j].image.sampler = sampler;
+                infos[j].image.imageView = getImage(context, model.albedoTexture)->view;
+                infos[j].image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            }
+            vkUpdateDescriptorSetWithTemplate(context->device, sets[i], updateTemplate, infos);
+        }
+        uint64_t templated = traceNowNs() - start;
+        if (templated < bestTemplate) bestTemplate = templated;
+    }
 
-    destroyImage(context, &image);
+    printf("Descriptor updates, %u sets of 3 descriptors, best of %u rounds:\n", setCount, rounds);
+    printf("  vkUpdateDescriptorSets            %8.1f ns/set\n", (double)bestWrites / setCount);
+    printf("  vkUpdateDescriptorSetWithTemplate %8.1f ns/set\n", (double)bestTemplate / setCount);
 
-    destroyBuffer(context, &spriteIndexBuffer);
-    destroyBuffer(context, &spriteVertexBuffer);
+    free(sets);
+    destroyDescriptorAllocator(context, &allocator);
+}
 
-    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
-        vkDestroyFence(context->device, fences[i], NULL);
-        vkDestroySemaphore(context->device, acrquireSemaphores[i], NULL);
-        vkDestroySemaphore(context->device, releaseSemaphores[i], NULL);
+void shutdownApplication() {
+    vkDeviceWaitIdle(context->device);
+    destroyDeletionQueue(context);
 
+    destroyFrameResources();
+    if (readbackRing.slots) {
+        destroyReadbackRing(context, &readbackRing);
     }
 
-    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
-        vkDestroyCommandPool(context->device, commandPools[i], NULL);
+    destroyDescriptorAllocator(context, &descriptorAllocator);
+    if (useBindless) {
+        destroyBindless(context, &bindless);
     }
+    destroyModel(context, &model);
+    destroyScene(&scene);
 
-    destroyPipeline(context, &spritePipeline);
-    destroyPipeline(context, &modelPipeline);
+    releaseImage(context, &image);
 
-    vkDestroySampler(context->device, sampler, NULL);
+    releaseBuffer(context, &spriteIndexBuffer);
+    releaseBuffer(context, &spriteVertexBuffer);
 
-    for (uint32_t i = 0; i < swapchain.imagesCount; i++) {
+    // destroyed by exitVulkan, the device is idle by then
+    releasePipeline(context, &spritePipeline, 0);
+    for (uint32_t i = 0; i < modelVariantCount; i++) {
+        releasePipeline(context, &modelVariants[i].pipeline, 0);
+    }
+    releasePipeline(context, &postPipeline, 0);
+
+    for (uint32_t i = 0; i < framebuffersCount; i++) {
         vkDestroyFramebuffer(context->device, framebuffers[i], NULL);
+    }
+    for (uint32_t i = 0; i < postFramebuffersCount; i++) {
+        vkDestroyFramebuffer(context->device, postFramebuffers[i], NULL);
+    }
+    for (uint32_t i = 0; i < attachmentsCount; i++) {
         destroyImage(context, &depthBuffers[i]);
-        destroyImage(context, &colorBuffers[i]);
+        if (colorBuffers[i].image) destroyImage(context, &colorBuffers[i]);
+        if (sceneColorBuffers[i].image) destroyImage(context, &sceneColorBuffers[i]);
     }
 
-    destroyRenderPass(context, renderPass);
+    if (renderPass) {
+        destroyRenderPass(context, renderPass);
+    }
+    if (postRenderPass) {
+        destroyRenderPass(context, postRenderPass);
+    }
     destroySwapchain(context, &swapchain);
     vkDestroySurfaceKHR(context->instance, surface, NULL);
     exitVulkan(context);
     free(framebuffers);
+    free(postFramebuffers);
+    free(depthBuffers);
+    free(colorBuffers);
+    free(sceneColorBuffers);
     free(context);
 
 }
 
-void updateApplication(double delta) {
-    
+static void updateCameraFromInput(double delta) {
     if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
         disCursorMode = true;
@@ -906,12 +1805,307 @@ void updateApplication(double delta) {
     front.Y = sin(degToRad(camera.pitch));
     front.Z = cos(degToRad(camera.pitch)) * cos(degToRad(camera.yaw));
     camera.cameraDirection = HMM_NormV3(front);
+}
+
+void updateApplication(double delta) {
+    lastInputTime = glfwGetTime();
+
+    if (bench.enabled) {
+        // input is ignored so every run renders the same frames
+        HMM_Vec3 target;
+        benchCameraPath(sceneTime, &camera.cameraPosition, &target);
+        camera.cameraDirection = HMM_NormV3(HMM_SubV3(target, camera.cameraPosition));
+    }
+    else {
+        updateCameraFromInput(delta);
+    }
+
     camera.proj = getProjectionInverseZ(degToRad(cameraFov), swapchain.width, swapchain.height, 0.01f);
     camera.view = HMM_LookAt_LH(camera.cameraPosition, HMM_AddV3(camera.cameraPosition, camera.cameraDirection), camera.up);
     camera.viewProj = HMM_MulM4(camera.proj, camera.view);
 }
 
-int main() {
+// Polls window events and updates the camera from the freshest input
+static void sampleInput() {
+    static double lastTime = 0.0;
+    double currentTime = glfwGetTime();
+    double delta = lastTime > 0.0 ? currentTime - lastTime : 0.0;
+    lastTime = currentTime;
+
+    sceneTime = currentTime;
+    if (bench.enabled) {
+        sceneTime = benchSceneTime(&bench);
+        delta = BENCH_TIME_STEP;
+    }
+
+    cpuProfilerBeginScope("update");
+    glfwPollEvents();
+    updateApplication(delta);
+    cpuProfilerEndScope();
+}
+
+static void printUsage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  --present-mode <fifo|fifo-relaxed|mailbox|immediate>\n");
+    printf("  --swapchain-images <count>\n");
+    printf("  --frames-in-flight <count>\n");
+    printf("  --depth-format <d16|d24|d32>\n");
+    printf("  --aa <off|msaa2|msaa4|msaa8|fxaa>\n");
+    printf("  --dynamic-resolution <target gpu ms>\n");
+    printf("  --min-render-scale <0.1..1>\n");
+    printf("  --sharpness <0..1>\n");
+    printf("  --dynamic-rendering\n");
+    printf("  --bindless            textures and materials from one descriptor indexing set, indexed per draw\n");
+    printf("  --no-push-constants   per draw transforms through dynamic uniform buffers even when they fit\n");
+    printf("  --shading <lit|normals|unlit>\n");
+    printf("  --no-specular\n");
+    printf("  --front-face <cw|ccw> winding of the model's front faces (default cw)\n");
+    printf("  --no-culling          draw the model's back faces too\n");
+    printf("  --anisotropy <1..16>  anisotropic filtering of the model textures (default 16, 1 = off)\n");
+    printf("  --scene <model|sprite> what is drawn (default model)\n");
+    printf("  --scene-nodes <count> add <count> moving scene nodes that are updated every frame but not drawn\n");
+    printf("  --scene-threads <count> threads updating the scene transforms (default one per cpu)\n");
+    printf("  --low-latency\n");
+    printf("  --report-latency\n");
+    printf("  --trace <file.json>   chrome trace of the cpu and gpu scopes (chrome://tracing, ui.perfetto.dev)\n");
+    printf("  --cpu-stats <frames>  print p50/p95/p99/max of the cpu phases every <frames> frames\n");
+    printf("  --memory-stats <s>    print the gpu memory per category and the heap budgets every <s> seconds\n");
+    printf("  --descriptor-bench <sets> time writing <sets> descriptor sets with and without update templates\n");
+    printf("  --bench <frames>      render <frames> frames along a scripted camera path and report frame times\n");
+    printf("  --bench-seconds <s>   like --bench, but measure for <s> seconds\n");
+    printf("  --bench-warmup <frames> frames rendered before measuring (default %u)\n", BENCH_DEFAULT_WARMUP);
+    printf("  --bench-output <file> per frame cpu/gpu times, .json also gets the summary, anything else is csv\n");
+    printf("  --headless            no window, present to a headless surface (GLFW null platform)\n");
+    printf("  --no-validation       do not load VK_LAYER_KHRONOS_validation\n");
+    printf("  --capture <frame>     read back the presented image of frame <frame> (counted from 0)\n");
+    printf("  --capture-output <file.png>\n");
+    printf("  --golden <file.png>   compare the captured frame, the exit code is 1 if it differs\n");
+    printf("  --golden-tolerance <0..255> per channel difference that still matches (default 2)\n");
+    printf("  --golden-max-mismatch <percent> of pixels allowed to exceed the tolerance (default 0.1)\n");
+    printf("  --golden-diff <file.png> mismatched pixels marked red\n");
+    printf("Keys: P cycles present mode, I cycles swapchain images, F cycles frames in flight, L toggles low latency mode, M cycles anti aliasing, R toggles dynamic resolution\n");
+}
+
+static void parseArguments(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--present-mode") == 0 && i + 1 < argc) {
+            if (!parsePresentMode(argv[++i], &presentMode)) {
+                fprintf(stderr, "Unknown present mode: %s\n", argv[i]);
+                exit(-1);
+            }
+            presentModeRequested = true;
+        }
+        else if (strcmp(argv[i], "--swapchain-images") == 0 && i + 1 < argc) {
+            swapchainImageCount = (uint32_t)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--depth-format") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "d16") == 0) preferredDepthFormat = VK_FORMAT_D16_UNORM;
+            else if (strcmp(argv[i], "d24") == 0) preferredDepthFormat = VK_FORMAT_X8_D24_UNORM_PACK32;
+            else if (strcmp(argv[i], "d32") == 0) preferredDepthFormat = VK_FORMAT_D32_SFLOAT;
+            else {
+                fprintf(stderr, "Unknown depth format: %s\n", argv[i]);
+                exit(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--aa") == 0 && i + 1 < argc) {
+            i++;
+            aaMode = AA_MODE_MSAA;
+            if (strcmp(argv[i], "off") == 0) msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+            else if (strcmp(argv[i], "msaa2") == 0) msaaSamples = VK_SAMPLE_COUNT_2_BIT;
+            else if (strcmp(argv[i], "msaa4") == 0) msaaSamples = VK_SAMPLE_COUNT_4_BIT;
+            else if (strcmp(argv[i], "msaa8") == 0) msaaSamples = VK_SAMPLE_COUNT_8_BIT;
+            else if (strcmp(argv[i], "fxaa") == 0) aaMode = AA_MODE_FXAA;
+            else {
+                fprintf(stderr, "Unknown anti aliasing mode: %s\n", argv[i]);
+                exit(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--dynamic-resolution") == 0 && i + 1 < argc) {
+            dynamicResolution = true;
+            targetGpuTime = atof(argv[++i]);
+            if (targetGpuTime <= 0.0) {
+                fprintf(stderr, "Target gpu time must be positive!\n");
+                exit(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--min-render-scale") == 0 && i + 1 < argc) {
+            minRenderScale = (float)atof(argv[++i]);
+            if (minRenderScale < 0.1f) minRenderScale = 0.1f;
+            if (minRenderScale > 1.0f) minRenderScale = 1.0f;
+        }
+        else if (strcmp(argv[i], "--sharpness") == 0 && i + 1 < argc) {
+            sharpness = (float)atof(argv[++i]);
+            if (sharpness < 0.0f) sharpness = 0.0f;
+            if (sharpness > 1.0f) sharpness = 1.0f;
+        }
+        else if (strcmp(argv[i], "--dynamic-rendering") == 0) {
+            useDynamicRendering = true;
+        }
+        else if (strcmp(argv[i], "--bindless") == 0) {
+            useBindless = true;
+        }
+        else if (strcmp(argv[i], "--shading") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "lit") == 0) shading.mode = SHADING_LIT;
+            else if (strcmp(argv[i], "normals") == 0) shading.mode = SHADING_NORMALS;
+            else if (strcmp(argv[i], "unlit") == 0) shading.mode = SHADING_UNLIT;
+            else {
+                fprintf(stderr, "Unknown shading mode: %s\n", argv[i]);
+                exit(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--no-specular") == 0) {
+            shading.specular = VK_FALSE;
+        }
+        else if (strcmp(argv[i], "--front-face") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "cw") == 0) modelFrontFace = VK_FRONT_FACE_CLOCKWISE;
+            else if (strcmp(argv[i], "ccw") == 0) modelFrontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+            else {
+                fprintf(stderr, "Unknown front face: %s\n", argv[i]);
+                exit(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--no-culling") == 0) {
+            modelCulling = false;
+        }
+        else if (strcmp(argv[i], "--anisotropy") == 0 && i + 1 < argc) {
+            maxAnisotropy = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--no-push-constants") == 0) {
+            allowPushConstants = false;
+        }
+        else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "model") == 0) drawSprite = false;
+            else if (strcmp(argv[i], "sprite") == 0) drawSprite = true;
+            else {
+                fprintf(stderr, "Unknown scene: %s\n", argv[i]);
+                exit(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--scene-nodes") == 0 && i + 1 < argc) {
+            sceneStressNodes = (uint32_t)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--scene-threads") == 0 && i + 1 < argc) {
+            sceneThreads = (uint32_t)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--low-latency") == 0) {
+            lowLatencyMode = true;
+        }
+        else if (strcmp(argv[i], "--report-latency") == 0) {
+            reportLatency = true;
+        }
+        else if (strcmp(argv[i], "--cpu-stats") == 0 && i + 1 < argc) {
+            cpuStatsWindow = (uint32_t)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--memory-stats") == 0 && i + 1 < argc) {
+            memoryStatsInterval = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--descriptor-bench") == 0 && i + 1 < argc) {
+            descriptorBenchSets = (uint32_t)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            if (!traceOpen(&traceWriter, argv[++i])) {
+                exit(-1);
+            }
+            traceWriteThreadName(&traceWriter, TRACE_TID_GPU, "gpu: graphics queue");
+        }
+        else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            bench.enabled = true;
+            bench.frameCount = (uint32_t)atoi(argv[++i]);
+            if (bench.frameCount == 0) {
+                fprintf(stderr, "Benchmark frame count must be at least 1!\n");
+                exit(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--bench-seconds") == 0 && i + 1 < argc) {
+            bench.enabled = true;
+            bench.frameCount = 0;
+            bench.duration = atof(argv[++i]);
+            if (bench.duration <= 0.0) {
+                fprintf(stderr, "Benchmark duration must be positive!\n");
+                exit(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--bench-warmup") == 0 && i + 1 < argc) {
+            bench.warmupFrames = (uint32_t)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--bench-output") == 0 && i + 1 < argc) {
+            bench.outputPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            captureFrame = atoll(argv[++i]);
+            if (captureFrame < 0) {
+                fprintf(stderr, "Capture frame must not be negative!\n");
+                exit(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--capture-output") == 0 && i + 1 < argc) {
+            captureOutputPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+            goldenPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--golden-tolerance") == 0 && i + 1 < argc) {
+            goldenTolerance = (uint32_t)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--golden-max-mismatch") == 0 && i + 1 < argc) {
+            goldenMaxMismatch = atof(argv[++i]) / 100.0;
+        }
+        else if (strcmp(argv[i], "--golden-diff") == 0 && i + 1 < argc) {
+            goldenDiffPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        }
+        else if (strcmp(argv[i], "--no-validation") == 0) {
+            enableValidation = false;
+        }
+        else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+            framesInFlight = (uint32_t)atoi(argv[++i]);
+            if (framesInFlight == 0) {
+                fprintf(stderr, "Frames in flight must be at least 1!\n");
+                exit(-1);
+            }
+        }
+        else {
+            printUsage(argv[0]);
+            exit(argv[i][0] == '-' && argv[i][1] == 'h' ? 0 : -1);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+
+    parseArguments(argc, argv);
+
+    if ((captureOutputPath || goldenPath) && captureFrame < 0) {
+        fprintf(stderr, "--capture-output and --golden need --capture <frame>!\n");
+        return -1;
+    }
+    if (captureFrame >= 0) {
+        swapchainUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+
+    if (bench.enabled) {
+        // measure the renderer, not the display or the validation layer
+        if (!presentModeRequested) presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+        if (!benchBegin(&bench)) return -1;
+    }
+
+    if (cpuStatsWindow || traceWriter.file || bench.enabled) {
+        // a benchmark reports the phases over all measured frames, the window grows and is reset after the warmup
+        uint32_t statsWindow = cpuStatsWindow ? cpuStatsWindow : 120;
+        if (bench.enabled && !cpuStatsWindow) statsWindow = 0;
+        cpuProfilerInit(statsWindow);
+        cpuProfilerSetThreadName("main");
+    }
+
+    if (headless) {
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    }
 
     if (!glfwInit()) {
         fprintf(stderr, "Failed to initialize glfw!\n");
@@ -919,7 +2113,9 @@ int main() {
     }
 
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_PLATFORM, GLFW_PLATFORM_WAYLAND);
+    if (!headless) {
+        glfwWindowHint(GLFW_PLATFORM, GLFW_PLATFORM_WAYLAND);
+    }
     window = glfwCreateWindow(800, 600, "Vulkan C yeahh", NULL, NULL);
     if (!window) {
         fprintf(stderr, "Failed to create glfw window\n");
@@ -929,35 +2125,112 @@ int main() {
 
     glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetKeyCallback(window, key_callback);
 
     initApplication(window);
 
-    double delta = 0.0f;
-    double lastTime = glfwGetTime();
-    double frameCpuAvg = 0.0f;
+    if (captureFrame >= 0 && !(swapchain.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+        fprintf(stderr, "--capture needs swapchain images with VK_IMAGE_USAGE_TRANSFER_SRC_BIT, the surface does not support it!\n");
+        return -1;
+    }
+    if (captureFrame >= 0 && !createReadbackRing(context, &readbackRing, 2)) {
+        return -1;
+    }
+
+    if (descriptorBenchSets) {
+        runDescriptorBenchmark(descriptorBenchSets);
+    }
+
+    if (bench.enabled) {
+        bench.deviceName = context->physicalDeviceProperties.deviceName;
+        bench.presentMode = presentModeName(swapchain.presentMode);
+        bench.antiAliasing = antiAliasingName();
+        bench.width = swapchain.width;
+        bench.height = swapchain.height;
+        bench.framesInFlight = framesInFlight;
+    }
+
+    double lastLatencyReport = glfwGetTime();
+    double lastScaleReport = lastLatencyReport;
+    double lastMemoryReport = lastLatencyReport;
+    uint64_t frameCount = 0;
+    bool benchDone = false;
+    bool benchMeasuring = false;
 
     while (!glfwWindowShouldClose(window)) {
-        updateApplication(delta);
-        renderApplication();
-        glfwPollEvents();
+        if (!lowLatencyMode) {
+            sampleInput();
+        }
+
+        if (beginFrame()) {
+            if (lowLatencyMode) {
+                waitForFrameStart();
+                sampleInput();
+            }
+            renderApplication();
+
+            if (bench.enabled) {
+                benchDone = benchEndFrame(&bench);
+            }
+        }
 
         double currentTime = glfwGetTime();
-        delta = currentTime - lastTime;
-        lastTime = currentTime;
 
-#ifdef LOG_CPU_TIME
-        frameCpuAvg = frameCpuAvg * 0.95f + delta * 0.05f * 1000.0f;
-        printf("Frame Time: %lf\n", frameCpuAvg);
-#endif
+        if ((lowLatencyMode || reportLatency) && currentTime - lastLatencyReport > 1.0) {
+            printf("Estimated input-to-present latency: %.2lf ms (gpu %.2lf ms, record %.2lf ms)\n",
+                   latencyAvg, gpuFrameTimeAvg, cpuRecordTimeAvg);
+            lastLatencyReport = currentTime;
+        }
+        if (dynamicResolution && currentTime - lastScaleReport > 1.0) {
+            VkExtent2D extent = getSceneExtent();
+            printf("Render scale: %.2f (%ux%u), gpu %.2lf ms of %.2lf ms\n",
+                   renderScale, extent.width, extent.height, gpuFrameTimeAvg, targetGpuTime);
+            lastScaleReport = currentTime;
+        }
+        if (memoryStatsInterval > 0.0 && currentTime - lastMemoryReport > memoryStatsInterval) {
+            printMemorySnapshot(context, stdout);
+            lastMemoryReport = currentTime;
+        }
+
+        cpuProfilerEndFrame(&traceWriter);
+        if (bench.enabled && !benchMeasuring && bench.frame == bench.warmupFrames) {
+            if (!cpuStatsWindow) cpuProfilerResetStats();
+            benchMeasuring = true;
+        }
+        if (cpuStatsWindow && ++frameCount % cpuStatsWindow == 0) {
+            cpuProfilerPrintStats(stdout);
+        }
+        if (benchDone) {
+            break;
+        }
+    }
 
+    if (captureFrame >= 0 && !captureDone) {
+        vkDeviceWaitIdle(context->device);
+        processReadbacks();
+        if (!captureDone) {
+            fprintf(stderr, "Frame %ld was never captured!\n", captureFrame);
+            goldenFailed = goldenPath != NULL;
+        }
+    }
+
+    if (bench.enabled) {
+        // the last frames in flight have not been collected yet
+        vkDeviceWaitIdle(context->device);
+        for (uint32_t i = 0; i < framesInFlight; i++) {
+            readFrameTimings(i);
+        }
+        benchFinish(&bench);
     }
 
     shutdownApplication();
+    cpuProfilerShutdown();
+    traceClose(&traceWriter);
 
     glfwDestroyWindow(window);
     glfwTerminate();
 
-    return 0;
+    return goldenFailed ? 1 : 0;
 }
 
 
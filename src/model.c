@@ -1,5 +1,6 @@
 
 #include "../include/model.h"
+#include <string.h>
 #include <assert.h>
 #include <vulkan/vulkan_core.h>
 
@@ -24,6 +25,65 @@ void fillBuffer(uint32_t inputStride, void* inputData, uint32_t outputStride, vo
     }
 }
 
+// glTF stores the OpenGL enums
+#define GLTF_NEAREST 9728
+#define GLTF_LINEAR 9729
+#define GLTF_NEAREST_MIPMAP_NEAREST 9984
+#define GLTF_LINEAR_MIPMAP_NEAREST 9985
+#define GLTF_NEAREST_MIPMAP_LINEAR 9986
+#define GLTF_LINEAR_MIPMAP_LINEAR 9987
+#define GLTF_CLAMP_TO_EDGE 33071
+#define GLTF_MIRRORED_REPEAT 33648
+
+static VkSamplerAddressMode gltfAddressMode(int wrap) {
+    switch (wrap) {
+        case GLTF_CLAMP_TO_EDGE: return VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        case GLTF_MIRRORED_REPEAT: return VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+        default: return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    }
+}
+
+// Filters the glTF leaves undefined are linear
+static VulkanSamplerDesc gltfSamplerDesc(const cgltf_sampler* sampler) {
+    VulkanSamplerDesc result = {0};
+    result.magFilter = VK_FILTER_LINEAR;
+    result.minFilter = VK_FILTER_LINEAR;
+    result.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    result.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    result.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    result.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    if (!sampler) return result;
+
+    if ((int)sampler->mag_filter == GLTF_NEAREST) result.magFilter = VK_FILTER_NEAREST;
+
+    // without mipmapping only the base level is sampled (maxLod 0.25 is how the spec emulates it)
+    switch ((int)sampler->min_filter) {
+        case GLTF_NEAREST:
+            result.minFilter = VK_FILTER_NEAREST;
+            result.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+            result.maxLod = 0.25f;
+            break;
+        case GLTF_LINEAR:
+            result.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+            result.maxLod = 0.25f;
+            break;
+        case GLTF_NEAREST_MIPMAP_NEAREST:
+            result.minFilter = VK_FILTER_NEAREST;
+            result.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+            break;
+        case GLTF_NEAREST_MIPMAP_LINEAR:
+            result.minFilter = VK_FILTER_NEAREST;
+            break;
+        case GLTF_LINEAR_MIPMAP_NEAREST:
+            result.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+            break;
+    }
+
+    result.addressModeU = gltfAddressMode((int)sampler->wrap_s);
+    result.addressModeV = gltfAddressMode((int)sampler->wrap_t);
+    return result;
+}
+
 Model createModel(VulkanContext *context, const char *filepath) {
     Model result = {0};
 
@@ -32,7 +92,7 @@ Model createModel(VulkanContext *context, const char *filepath) {
 
     cgltf_result error = cgltf_parse_file(&options, filepath, &data);
     if (error == cgltf_result_success) {
-        error = cgltf_load_buffers(&options, data, "/home/ttchef/coding/c/Vulkan-Hello-Triangle/res/models");
+        error = cgltf_load_buffers(&options, data, filepath);
         if (error == cgltf_result_success) {
             assert(data->meshes_count == 1);
             assert(data->meshes[0].primitives_count == 1);
@@ -45,9 +105,10 @@ Model createModel(VulkanContext *context, const char *filepath) {
             uint64_t indexDataSize = data->meshes[0].primitives[0].indices->buffer_view->size;
             void* indexData = bufferBase + data->meshes[0].primitives[0].indices->buffer_view->offset;
 
-            createBuffer(context, &result.indexBuffer, indexDataSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-                         VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-            uploadDataToBuffer(context, &result.indexBuffer, indexData, indexDataSize);
+            result.indexBuffer = createPooledBuffer(context, indexDataSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                                                    VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VULKAN_MEMORY_GEOMETRY);
+            assert(result.indexBuffer.value);
+            uploadDataToBuffer(context, getBuffer(context, result.indexBuffer), indexData, indexDataSize);
             result.numIndices = data->meshes[0].primitives[0].indices->count;
 
             // Vertices
@@ -76,33 +137,46 @@ Model createModel(VulkanContext *context, const char *filepath) {
                 }
             }
 
-            createBuffer(context, &result.vertexBuffer, vertexDataSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-                 VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-            uploadDataToBuffer(context, &result.vertexBuffer, vertexData, vertexDataSize);
+            result.vertexBuffer = createPooledBuffer(context, vertexDataSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VULKAN_MEMORY_GEOMETRY);
+            assert(result.vertexBuffer.value);
+            uploadDataToBuffer(context, getBuffer(context, result.vertexBuffer), vertexData, vertexDataSize);
             free(vertexData);
 
-            // Material
-            assert(data->materials_count == 1);
-            cgltf_material* material = &data->materials[0];
-            assert(material->has_pbr_metallic_roughness);
-            cgltf_texture_view albedoTextureView = material->pbr_metallic_roughness.base_color_texture;
-            assert(!albedoTextureView.has_transform);
-            assert(albedoTextureView.texcoord == 0);
-            assert(albedoTextureView.texture);
-            cgltf_texture* albedoTexture = albedoTextureView.texture;
+            // Material, models without one or without an albedo texture are drawn white
+            assert(data->materials_count <= 1);
+            cgltf_texture* albedoTexture = NULL;
+            for (uint32_t i = 0; i < 4; i++) result.baseColorFactor[i] = 1.0f;
+            result.albedoSampler = gltfSamplerDesc(NULL);
+            if (data->materials_count == 1) {
+                cgltf_material* material = &data->materials[0];
+                assert(material->has_pbr_metallic_roughness);
+                cgltf_texture_view albedoTextureView = material->pbr_metallic_roughness.base_color_texture;
+                assert(!albedoTextureView.has_transform);
+                assert(albedoTextureView.texcoord == 0);
+                albedoTexture = albedoTextureView.texture;
+                memcpy(result.baseColorFactor, material->pbr_metallic_roughness.base_color_factor, sizeof(result.baseColorFactor));
+                if (albedoTexture) result.albedoSampler = gltfSamplerDesc(albedoTexture->sampler);
+            }
 
             // Load texture
-            cgltf_buffer_view* bufferView = albedoTexture->image->buffer_view;
-            assert(bufferView->size < INT32_MAX);
-            int bpp, width, height;
-            uint8_t* textureData = stbi_load_from_memory((stbi_uc*)bufferView->buffer->data, (int)bufferView->size, &width, &height, &bpp, 4);
-            assert(textureData);
-            bpp = 4;
-            createImage(context, &result.albedoTexture, width, height, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_SAMPLED_BIT |
-                        VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT);
-            uploadDataToImage(context, &result.albedoTexture, textureData, width * height * bpp, width, height,
+            uint8_t whitePixel[4] = {255, 255, 255, 255};
+            uint8_t* textureData = whitePixel;
+            int bpp = 4, width = 1, height = 1;
+            if (albedoTexture) {
+                cgltf_buffer_view* bufferView = albedoTexture->image->buffer_view;
+                assert(bufferView->size < INT32_MAX);
+                textureData = stbi_load_from_memory((stbi_uc*)bufferView->buffer->data + bufferView->offset, (int)bufferView->size,
+                                                    &width, &height, &bpp, 4);
+                assert(textureData);
+                bpp = 4;
+            }
+            result.albedoTexture = createPooledImage(context, width, height, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_SAMPLED_BIT |
+                                                     VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT, VULKAN_MEMORY_TEXTURE);
+            assert(result.albedoTexture.value);
+            uploadDataToImage(context, getImage(context, result.albedoTexture), textureData, width * height * bpp, width, height,
                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT);
-            stbi_image_free(textureData);
+            if (textureData != whitePixel) stbi_image_free(textureData);
         }
         else {
             fprintf(stderr, "Could not load additional buffers!\n");
@@ -120,9 +194,9 @@ Model createModel(VulkanContext *context, const char *filepath) {
 }
 
 void destroyModel(VulkanContext *context, Model *model) {
-    destroyBuffer(context, &model->vertexBuffer);
-    destroyBuffer(context, &model->indexBuffer);
-    destroyImage(context, &model->albedoTexture);
+    releaseBuffer(context, &model->vertexBuffer);
+    releaseBuffer(context, &model->indexBuffer);
+    releaseImage(context, &model->albedoTexture);
     *model = (Model){0};
 }
 
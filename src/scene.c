@@ -0,0 +1,328 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/scene.h"
+#include "../include/cpu_profiler.h"
+
+static bool growArray(void** array, size_t elementSize, uint32_t count) {
+    void* grown = realloc(*array, elementSize * count);
+    if (!grown) return false;
+    *array = grown;
+    return true;
+}
+
+static bool growScene(Scene* scene, uint32_t capacity) {
+    if (!growArray((void**)&scene->parents, sizeof(uint32_t), capacity) ||
+        !growArray((void**)&scene->depths, sizeof(uint32_t), capacity) ||
+        !growArray((void**)&scene->nodes, sizeof(SceneNode), capacity) ||
+        !growArray((void**)&scene->locals, sizeof(HMM_Mat4), capacity) ||
+        !growArray((void**)&scene->worlds, sizeof(HMM_Mat4), capacity) ||
+        !growArray((void**)&scene->modelViews, sizeof(HMM_Mat4), capacity) ||
+        !growArray((void**)&scene->modelViewProjs, sizeof(HMM_Mat4), capacity) ||
+        !growArray((void**)&scene->normalMatrices, sizeof(NormalMatrix), capacity) ||
+        !growArray((void**)&scene->dirty, sizeof(uint8_t), capacity) ||
+        !growArray((void**)&scene->positions, sizeof(uint32_t), capacity) ||
+        !growArray((void**)&scene->levelStarts, sizeof(uint32_t), capacity + 1)) {
+        fprintf(stderr, "Failed to grow scene to %u nodes!\n", capacity);
+        return false;
+    }
+    scene->capacity = capacity;
+    return true;
+}
+
+// Splits [begin, end) between the threads of the update. Short ranges are left to
+// the first threads so nobody works on a handful of nodes.
+static void splitRange(uint32_t begin, uint32_t end, uint32_t part, uint32_t parts, uint32_t* partBegin, uint32_t* partEnd) {
+    uint32_t count = end - begin;
+    uint32_t used = count / SCENE_MIN_BATCH;
+    if (used < 1) used = 1;
+    if (used > parts) used = parts;
+
+    uint32_t size = (count + used - 1) / used;
+    uint32_t first = part < used ? part * size : count;
+    uint32_t last = part < used ? first + size : count;
+    *partBegin = begin + (first < count ? first : count);
+    *partEnd = begin + (last < count ? last : count);
+}
+
+// The level above is complete, so a parent's dirty flag already includes its ancestors.
+// Dirty siblings next to each other are multiplied by their parent world as one batch.
+static void updateWorlds(Scene* scene, uint32_t begin, uint32_t end) {
+    uint32_t i = begin;
+    while (i < end) {
+        uint32_t parent = scene->parents[i];
+        if (parent != SCENE_NO_PARENT) scene->dirty[i] |= scene->dirty[parent];
+        if (!scene->dirty[i]) {
+            i++;
+            continue;
+        }
+
+        uint32_t runEnd = i + 1;
+        while (runEnd < end && scene->parents[runEnd] == parent) {
+            if (parent != SCENE_NO_PARENT) scene->dirty[runEnd] |= scene->dirty[parent];
+            if (!scene->dirty[runEnd]) break;
+            runEnd++;
+        }
+
+        if (parent == SCENE_NO_PARENT) {
+            memcpy(&scene->worlds[i], &scene->locals[i], sizeof(HMM_Mat4) * (runEnd - i));
+        }
+        else {
+            multiplyMatrices(&scene->worlds[parent], &scene->locals[i], &scene->worlds[i], runEnd - i);
+        }
+        i = runEnd;
+    }
+}
+
+static void updateViews(Scene* scene, uint32_t begin, uint32_t end) {
+    bool all = scene->viewChanged;
+    uint32_t i = begin;
+    while (i < end) {
+        if (!all && !scene->dirty[i]) {
+            i++;
+            continue;
+        }
+
+        uint32_t runEnd = i + 1;
+        while (runEnd < end && (all || scene->dirty[runEnd])) runEnd++;
+
+        uint32_t count = runEnd - i;
+        multiplyMatrices(&scene->view, &scene->worlds[i], &scene->modelViews[i], count);
+        multiplyMatrices(&scene->viewProj, &scene->worlds[i], &scene->modelViewProjs[i], count);
+        computeNormalMatrices(&scene->modelViews[i], &scene->normalMatrices[i], count);
+        i = runEnd;
+    }
+}
+
+static void updatePart(Scene* scene, uint32_t part) {
+    uint32_t parts = scene->participants;
+    uint32_t begin, end;
+
+    for (uint32_t level = 0; level < scene->levelCount; level++) {
+        splitRange(scene->levelStarts[level], scene->levelStarts[level + 1], part, parts, &begin, &end);
+        updateWorlds(scene, begin, end);
+        if (parts > 1) pthread_barrier_wait(&scene->barrier);
+    }
+
+    // every world is final, the dirty flags are only read by the owner of the range from here on
+    splitRange(0, scene->count, part, parts, &begin, &end);
+    updateViews(scene, begin, end);
+    memset(&scene->dirty[begin], 0, end - begin);
+}
+
+static void* sceneWorker(void* argument) {
+    Scene* scene = argument;
+    cpuProfilerSetThreadName("scene worker");
+
+    for (;;) {
+        pthread_barrier_wait(&scene->barrier);
+        if (scene->quit) break;
+
+        cpuProfilerBeginScope("scene worker");
+        updatePart(scene, atomic_fetch_add(&scene->nextPart, 1));
+        cpuProfilerEndScope();
+
+        pthread_barrier_wait(&scene->barrier);
+    }
+    return NULL;
+}
+
+bool createScene(Scene* scene, uint32_t capacity, uint32_t threadCount) {
+    *scene = (Scene){0};
+    if (!growScene(scene, capacity ? capacity : 64)) {
+        destroyScene(scene);
+        return false;
+    }
+    scene->levelStarts[0] = 0;
+    scene->sorted = true;
+
+    if (threadCount == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = cpus > 0 ? (uint32_t)cpus : 1;
+    }
+    if (threadCount > SCENE_MAX_THREADS) threadCount = SCENE_MAX_THREADS;
+    scene->threadCount = threadCount;
+
+    if (threadCount > 1) {
+        if (pthread_barrier_init(&scene->barrier, NULL, threadCount) != 0) {
+            fprintf(stderr, "Failed to create scene barrier, updating on one thread!\n");
+            scene->threadCount = 1;
+            return true;
+        }
+        for (uint32_t i = 0; i < threadCount - 1; i++) {
+            // the barrier waits for every thread, the scene can not continue with fewer
+            if (pthread_create(&scene->workers[i], NULL, sceneWorker, scene) != 0) {
+                fprintf(stderr, "Failed to create scene worker thread!\n");
+                exit(-1);
+            }
+        }
+    }
+    return true;
+}
+
+void destroyScene(Scene* scene) {
+    if (scene->threadCount > 1) {
+        scene->quit = true;
+        pthread_barrier_wait(&scene->barrier);
+        for (uint32_t i = 0; i < scene->threadCount - 1; i++) {
+            pthread_join(scene->workers[i], NULL);
+        }
+        pthread_barrier_destroy(&scene->barrier);
+    }
+
+    free(scene->parents);
+    free(scene->depths);
+    free(scene->nodes);
+    free(scene->locals);
+    free(scene->worlds);
+    free(scene->modelViews);
+    free(scene->modelViewProjs);
+    free(scene->normalMatrices);
+    free(scene->dirty);
+    free(scene->positions);
+    free(scene->levelStarts);
+    *scene = (Scene){0};
+}
+
+SceneNode sceneAddNode(Scene* scene, SceneNode parent, const HMM_Mat4* local) {
+    if (scene->count == scene->capacity && !growScene(scene, scene->capacity * 2)) {
+        return SCENE_INVALID_NODE;
+    }
+
+    uint32_t position = scene->count;
+    uint32_t parentPosition = parent == SCENE_NO_PARENT ? SCENE_NO_PARENT : scene->positions[parent];
+    uint32_t depth = parent == SCENE_NO_PARENT ? 0 : scene->depths[parentPosition] + 1;
+
+    // appending keeps the breadth first order when the node sorts after the last one
+    if (scene->sorted && position > 0) {
+        uint32_t lastDepth = scene->depths[position - 1];
+        uint32_t lastParent = scene->parents[position - 1];
+        if (depth < lastDepth || (depth == lastDepth && parent != SCENE_NO_PARENT && parentPosition < lastParent)) {
+            scene->sorted = false;
+        }
+    }
+    if (scene->sorted) {
+        if (depth == scene->levelCount) scene->levelCount++;
+        scene->levelStarts[scene->levelCount] = position + 1;
+    }
+
+    SceneNode node = scene->count++;
+    scene->parents[position] = parentPosition;
+    scene->depths[position] = depth;
+    scene->nodes[position] = node;
+    scene->locals[position] = *local;
+    scene->dirty[position] = 1;
+    scene->positions[node] = position;
+    return node;
+}
+
+void sceneSetLocal(Scene* scene, SceneNode node, const HMM_Mat4* local) {
+    uint32_t position = scene->positions[node];
+    scene->locals[position] = *local;
+    scene->dirty[position] = 1;
+}
+
+// Breadth first from the roots gives the depth order with siblings next to each other.
+// Only the inputs are moved, everything is marked dirty and recomputed by the update.
+static bool sortScene(Scene* scene) {
+    uint32_t count = scene->count;
+    uint32_t* childStarts = calloc(count + 1, sizeof(uint32_t));
+    uint32_t* children = malloc(sizeof(uint32_t) * (count ? count : 1));
+    uint32_t* order = malloc(sizeof(uint32_t) * (count ? count : 1));
+    uint32_t* cursors = malloc(sizeof(uint32_t) * (count ? count : 1));
+    HMM_Mat4* scratch = malloc(sizeof(HMM_Mat4) * (count ? count : 1));
+    if (!childStarts || !children || !order || !cursors || !scratch) {
+        fprintf(stderr, "Failed to allocate scene sort buffers!\n");
+        free(childStarts);
+        free(children);
+        free(order);
+        free(cursors);
+        free(scratch);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (scene->parents[i] != SCENE_NO_PARENT) childStarts[scene->parents[i] + 1]++;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        childStarts[i + 1] += childStarts[i];
+        cursors[i] = childStarts[i];
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (scene->parents[i] != SCENE_NO_PARENT) children[cursors[scene->parents[i]]++] = i;
+    }
+
+    uint32_t orderCount = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (scene->parents[i] == SCENE_NO_PARENT) order[orderCount++] = i;
+    }
+    for (uint32_t head = 0; head < orderCount; head++) {
+        uint32_t parent = order[head];
+        for (uint32_t j = childStarts[parent]; j < childStarts[parent + 1]; j++) {
+            order[orderCount++] = children[j];
+        }
+    }
+
+    // cursors becomes old position -> new position
+    for (uint32_t i = 0; i < count; i++) cursors[order[i]] = i;
+
+    for (uint32_t i = 0; i < count; i++) scratch[i] = scene->locals[order[i]];
+    memcpy(scene->locals, scratch, sizeof(HMM_Mat4) * count);
+
+    uint32_t* values = (uint32_t*)scratch;
+    for (uint32_t i = 0; i < count; i++) values[i] = scene->depths[order[i]];
+    memcpy(scene->depths, values, sizeof(uint32_t) * count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t parent = scene->parents[order[i]];
+        values[i] = parent == SCENE_NO_PARENT ? SCENE_NO_PARENT : cursors[parent];
+    }
+    memcpy(scene->parents, values, sizeof(uint32_t) * count);
+
+    for (uint32_t i = 0; i < count; i++) values[i] = scene->nodes[order[i]];
+    memcpy(scene->nodes, values, sizeof(uint32_t) * count);
+
+    for (uint32_t i = 0; i < count; i++) scene->positions[scene->nodes[i]] = i;
+    memset(scene->dirty, 1, count);
+    scene->viewValid = false;
+
+    scene->levelCount = 0;
+    scene->levelStarts[0] = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (scene->depths[i] == scene->levelCount) scene->levelCount++;
+        scene->levelStarts[scene->levelCount] = i + 1;
+    }
+    scene->sorted = true;
+
+    free(childStarts);
+    free(children);
+    free(order);
+    free(cursors);
+    free(scratch);
+    return true;
+}
+
+void updateScene(Scene* scene, const HMM_Mat4* view, const HMM_Mat4* viewProj) {
+    if (!scene->sorted && !sortScene(scene)) return;
+
+    scene->viewChanged = !scene->viewValid || memcmp(&scene->view, view, sizeof(HMM_Mat4)) != 0 ||
+                         memcmp(&scene->viewProj, viewProj, sizeof(HMM_Mat4)) != 0;
+    scene->view = *view;
+    scene->viewProj = *viewProj;
+    scene->viewValid = true;
+
+    if (scene->threadCount > 1 && scene->count >= SCENE_PARALLEL_MIN_NODES) {
+        scene->participants = scene->threadCount;
+        atomic_store(&scene->nextPart, 1);
+        pthread_barrier_wait(&scene->barrier);
+        updatePart(scene, 0);
+        pthread_barrier_wait(&scene->barrier);
+    }
+    else {
+        scene->participants = 1;
+        updatePart(scene, 0);
+    }
+}
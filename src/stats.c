@@ -0,0 +1,35 @@
+#include <stdlib.h>
+
+#include "../include/stats.h"
+
+static int compareDoubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+double percentile(const double* sorted, uint32_t count, double p) {
+    uint32_t rank = (uint32_t)(p * count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+SampleStats computeSampleStats(double* values, uint32_t count) {
+    SampleStats stats = {0};
+    if (count == 0) return stats;
+
+    qsort(values, count, sizeof(double), compareDoubles);
+
+    double sum = 0.0;
+    for (uint32_t i = 0; i < count; i++) sum += values[i];
+
+    stats.samples = count;
+    stats.avgMs = sum / count;
+    stats.minMs = values[0];
+    stats.p50Ms = percentile(values, count, 0.50);
+    stats.p95Ms = percentile(values, count, 0.95);
+    stats.p99Ms = percentile(values, count, 0.99);
+    stats.maxMs = values[count - 1];
+    return stats;
+}
@@ -0,0 +1,66 @@
+
+#include <stdio.h>
+#include <time.h>
+
+#include "../include/trace.h"
+
+uint64_t traceNowNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+bool traceOpen(TraceWriter* writer, const char* path) {
+    writer->file = fopen(path, "w");
+    if (!writer->file) {
+        fprintf(stderr, "Failed to open trace file: %s\n", path);
+        return false;
+    }
+
+    fprintf(writer->file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    writer->firstEvent = true;
+    return true;
+}
+
+void traceClose(TraceWriter* writer) {
+    if (!writer->file) return;
+
+    fprintf(writer->file, "\n]}\n");
+    fclose(writer->file);
+    writer->file = NULL;
+}
+
+// names are identifiers from the code, only quotes and backslashes need escaping
+static void writeString(FILE* file, const char* string) {
+    fputc('"', file);
+    for (const char* c = string; *c; c++) {
+        if (*c == '"' || *c == '\\') fputc('\\', file);
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+static void beginEvent(TraceWriter* writer) {
+    if (!writer->firstEvent) fputs(",\n", writer->file);
+    writer->firstEvent = false;
+}
+
+void traceWriteComplete(TraceWriter* writer, const char* name, const char* category,
+                        uint32_t tid, uint64_t startNs, uint64_t durationNs) {
+    if (!writer || !writer->file) return;
+
+    beginEvent(writer);
+    fprintf(writer->file, "{\"name\":");
+    writeString(writer->file, name);
+    fprintf(writer->file, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            category, TRACE_PID, tid, (double)startNs * 1e-3, (double)durationNs * 1e-3);
+}
+
+void traceWriteThreadName(TraceWriter* writer, uint32_t tid, const char* name) {
+    if (!writer || !writer->file) return;
+
+    beginEvent(writer);
+    fprintf(writer->file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":", TRACE_PID, tid);
+    writeString(writer->file, name);
+    fprintf(writer->file, "}}");
+}
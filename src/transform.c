@@ -0,0 +1,111 @@
+
+#include "../include/transform.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define TRANSFORM_USE_SSE
+#endif
+
+// The inverse transpose of a 3x3 matrix with columns a, b, c is
+// (b x c, c x a, a x b) / det, with det = a . (b x c)
+NormalMatrix computeNormalMatrix(const HMM_Mat4* modelView) {
+    const float* a = modelView->Elements[0];
+    const float* b = modelView->Elements[1];
+    const float* c = modelView->Elements[2];
+
+    float bc[3] = { b[1] * c[2] - b[2] * c[1], b[2] * c[0] - b[0] * c[2], b[0] * c[1] - b[1] * c[0] };
+    float ca[3] = { c[1] * a[2] - c[2] * a[1], c[2] * a[0] - c[0] * a[2], c[0] * a[1] - c[1] * a[0] };
+    float ab[3] = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+
+    float det = a[0] * bc[0] + a[1] * bc[1] + a[2] * bc[2];
+    float invDet = det != 0.0f ? 1.0f / det : 0.0f;
+
+    NormalMatrix result = {0};
+    for (uint32_t i = 0; i < 3; i++) {
+        result.columns[0][i] = bc[i] * invDet;
+        result.columns[1][i] = ca[i] * invDet;
+        result.columns[2][i] = ab[i] * invDet;
+    }
+    return result;
+}
+
+#ifdef TRANSFORM_USE_SSE
+// Four matrices per iteration: the columns are transposed so each register holds one
+// component of four matrices, the cross products then need no shuffles.
+static void computeNormalMatrices4(const HMM_Mat4* modelViews, NormalMatrix* normalMatrices) {
+    __m128 x[3], y[3], z[3];
+    for (uint32_t column = 0; column < 3; column++) {
+        __m128 m0 = _mm_loadu_ps(modelViews[0].Elements[column]);
+        __m128 m1 = _mm_loadu_ps(modelViews[1].Elements[column]);
+        __m128 m2 = _mm_loadu_ps(modelViews[2].Elements[column]);
+        __m128 m3 = _mm_loadu_ps(modelViews[3].Elements[column]);
+        _MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+        x[column] = m0;
+        y[column] = m1;
+        z[column] = m2;
+    }
+
+    // columns of the cofactor matrix: b x c, c x a, a x b
+    __m128 nx[3], ny[3], nz[3];
+    for (uint32_t column = 0; column < 3; column++) {
+        uint32_t u = (column + 1) % 3;
+        uint32_t v = (column + 2) % 3;
+        nx[column] = _mm_sub_ps(_mm_mul_ps(y[u], z[v]), _mm_mul_ps(z[u], y[v]));
+        ny[column] = _mm_sub_ps(_mm_mul_ps(z[u], x[v]), _mm_mul_ps(x[u], z[v]));
+        nz[column] = _mm_sub_ps(_mm_mul_ps(x[u], y[v]), _mm_mul_ps(y[u], x[v]));
+    }
+
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x[0], nx[0]), _mm_mul_ps(y[0], ny[0])), _mm_mul_ps(z[0], nz[0]));
+    __m128 nonSingular = _mm_cmpneq_ps(det, _mm_setzero_ps());
+    __m128 invDet = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), det), nonSingular);
+
+    for (uint32_t column = 0; column < 3; column++) {
+        __m128 m0 = _mm_mul_ps(nx[column], invDet);
+        __m128 m1 = _mm_mul_ps(ny[column], invDet);
+        __m128 m2 = _mm_mul_ps(nz[column], invDet);
+        __m128 m3 = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+        _mm_storeu_ps(normalMatrices[0].columns[column], m0);
+        _mm_storeu_ps(normalMatrices[1].columns[column], m1);
+        _mm_storeu_ps(normalMatrices[2].columns[column], m2);
+        _mm_storeu_ps(normalMatrices[3].columns[column], m3);
+    }
+}
+#endif
+
+void computeNormalMatrices(const HMM_Mat4* modelViews, NormalMatrix* normalMatrices, uint32_t count) {
+    uint32_t i = 0;
+#ifdef TRANSFORM_USE_SSE
+    for (; i + 4 <= count; i += 4) {
+        computeNormalMatrices4(&modelViews[i], &normalMatrices[i]);
+    }
+#endif
+    for (; i < count; i++) {
+        normalMatrices[i] = computeNormalMatrix(&modelViews[i]);
+    }
+}
+
+void multiplyMatrices(const HMM_Mat4* left, const HMM_Mat4* rights, HMM_Mat4* results, uint32_t count) {
+#ifdef TRANSFORM_USE_SSE
+    __m128 a = _mm_loadu_ps(left->Elements[0]);
+    __m128 b = _mm_loadu_ps(left->Elements[1]);
+    __m128 c = _mm_loadu_ps(left->Elements[2]);
+    __m128 d = _mm_loadu_ps(left->Elements[3]);
+
+    // each result column is a linear combination of the left columns
+    for (uint32_t i = 0; i < count; i++) {
+        for (uint32_t column = 0; column < 4; column++) {
+            const float* r = rights[i].Elements[column];
+            __m128 x = _mm_mul_ps(a, _mm_set1_ps(r[0]));
+            __m128 y = _mm_mul_ps(b, _mm_set1_ps(r[1]));
+            __m128 z = _mm_mul_ps(c, _mm_set1_ps(r[2]));
+            __m128 w = _mm_mul_ps(d, _mm_set1_ps(r[3]));
+            _mm_storeu_ps(results[i].Elements[column], _mm_add_ps(_mm_add_ps(x, y), _mm_add_ps(z, w)));
+        }
+    }
+#else
+    for (uint32_t i = 0; i < count; i++) {
+        results[i] = HMM_MulM4(*left, rights[i]);
+    }
+#endif
+}
@@ -0,0 +1,182 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan_core.h>
+
+#include "../include/vulkan_base.h"
+
+bool createBindless(VulkanContext* context, VulkanBindless* bindless, uint32_t textureCapacity, uint32_t materialCapacity) {
+    *bindless = (VulkanBindless){0};
+
+    if (!context->supportsDescriptorIndexing) {
+        fprintf(stderr, "Device does not support descriptor indexing, bindless disabled!\n");
+        return false;
+    }
+
+    VkPhysicalDeviceVulkan12Properties properties12 = {0};
+    properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties = {0};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &properties12;
+    vkGetPhysicalDeviceProperties2(context->physicalDevice, &properties);
+
+    // combined image samplers count against both the sampled image and the sampler limits
+    uint32_t limits[] = {
+        properties12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+        properties12.maxPerStageDescriptorUpdateAfterBindSamplers,
+        properties12.maxDescriptorSetUpdateAfterBindSamplers,
+    };
+    for (uint32_t i = 0; i < ARRAY_COUNT(limits); i++) {
+        if (textureCapacity > limits[i]) textureCapacity = limits[i];
+    }
+    bindless->textureCapacity = textureCapacity;
+    bindless->materialCapacity = materialCapacity;
+
+    // unused texture slots stay unwritten, new ones are written while the set is bound and
+    // while submitted frames that never index them still use the set
+    VkDescriptorBindingFlags bindingFlags[] = {
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+    };
+
+    VkDescriptorSetLayoutBinding bindings[] = {
+        { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCapacity, VK_SHADER_STAGE_FRAGMENT_BIT, 0 },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0 },
+    };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {0};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = ARRAY_COUNT(bindingFlags);
+    bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {0};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = ARRAY_COUNT(bindings);
+    layoutInfo.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(context->device, &layoutInfo, NULL, &bindless->layout) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create bindless descriptor layout!\n");
+        return false;
+    }
+
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCapacity },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+    };
+
+    VkDescriptorPoolCreateInfo poolInfo = {0};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = ARRAY_COUNT(poolSizes);
+    poolInfo.pPoolSizes = poolSizes;
+
+    if (vkCreateDescriptorPool(context->device, &poolInfo, NULL, &bindless->pool) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create bindless descriptor pool!\n");
+        destroyBindless(context, bindless);
+        return false;
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo = {0};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = bindless->pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &bindless->layout;
+
+    if (vkAllocateDescriptorSets(context->device, &allocInfo, &bindless->set) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate bindless descriptor set!\n");
+        destroyBindless(context, bindless);
+        return false;
+    }
+
+    // written by the cpu while frames read other materials, so it stays mapped in host memory
+    VkDeviceSize materialSize = sizeof(VulkanMaterial) * materialCapacity;
+    createBuffer(context, &bindless->materialBuffer, materialSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VULKAN_MEMORY_UNIFORM);
+    if (!bindless->materialBuffer.memory) {
+        destroyBindless(context, bindless);
+        return false;
+    }
+
+    void* mapped;
+    if (vkMapMemory(context->device, bindless->materialBuffer.memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to map material buffer!\n");
+        destroyBindless(context, bindless);
+        return false;
+    }
+    bindless->materials = mapped;
+
+    VkDescriptorBufferInfo bufferInfo = {0};
+    bufferInfo.buffer = bindless->materialBuffer.buffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = materialSize;
+
+    VkWriteDescriptorSet descriptorWrite = {0};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = bindless->set;
+    descriptorWrite.dstBinding = 1;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrite.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(context->device, 1, &descriptorWrite, 0, NULL);
+
+    return true;
+}
+
+void destroyBindless(VulkanContext* context, VulkanBindless* bindless) {
+    if (bindless->materials) {
+        vkUnmapMemory(context->device, bindless->materialBuffer.memory);
+    }
+    if (bindless->materialBuffer.buffer) {
+        destroyBuffer(context, &bindless->materialBuffer);
+    }
+    if (bindless->pool) {
+        vkDestroyDescriptorPool(context->device, bindless->pool, NULL);
+    }
+    if (bindless->layout) {
+        vkDestroyDescriptorSetLayout(context->device, bindless->layout, NULL);
+    }
+    *bindless = (VulkanBindless){0};
+}
+
+// Returns the index of the texture in the array, UINT32_MAX if it is full
+uint32_t bindlessAddTexture(VulkanContext* context, VulkanBindless* bindless, VkImageView view, VkSampler sampler) {
+    if (bindless->textureCount == bindless->textureCapacity) {
+        fprintf(stderr, "Bindless texture array is full (%u textures)!\n", bindless->textureCapacity);
+        return UINT32_MAX;
+    }
+    uint32_t index = bindless->textureCount++;
+
+    VkDescriptorImageInfo imageInfo = {0};
+    imageInfo.sampler = sampler;
+    imageInfo.imageView = view;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet descriptorWrite = {0};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = bindless->set;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = index;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(context->device, 1, &descriptorWrite, 0, NULL);
+
+    return index;
+}
+
+// Returns the material index the shaders read, UINT32_MAX if the buffer is full
+uint32_t bindlessAddMaterial(VulkanBindless* bindless, const VulkanMaterial* material) {
+    if (bindless->materialCount == bindless->materialCapacity) {
+        fprintf(stderr, "Bindless material buffer is full (%u materials)!\n", bindless->materialCapacity);
+        return UINT32_MAX;
+    }
+    uint32_t index = bindless->materialCount++;
+    bindless->materials[index] = *material;
+    return index;
+}
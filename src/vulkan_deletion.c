@@ -0,0 +1,137 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan_core.h>
+
+#include "../include/vulkan_base.h"
+
+static void destroyDeletion(VulkanContext* context, VulkanDeletion* deletion) {
+    switch (deletion->type) {
+        case VULKAN_DELETION_BUFFER:
+            destroyBuffer(context, &deletion->as.buffer);
+            break;
+        case VULKAN_DELETION_IMAGE:
+            destroyImage(context, &deletion->as.image);
+            break;
+        case VULKAN_DELETION_FRAMEBUFFER:
+            vkDestroyFramebuffer(context->device, deletion->as.framebuffer, NULL);
+            break;
+        case VULKAN_DELETION_RENDER_PASS:
+            destroyRenderPass(context, deletion->as.renderPass);
+            break;
+        case VULKAN_DELETION_SWAPCHAIN:
+            destroySwapchain(context, &deletion->as.swapchain);
+            break;
+        case VULKAN_DELETION_PIPELINE:
+            destroyPipeline(context, &deletion->as.pipeline);
+            break;
+        case VULKAN_DELETION_PIPELINE_LAYOUT:
+            vkDestroyPipelineLayout(context->device, deletion->as.pipelineLayout, NULL);
+            break;
+        case VULKAN_DELETION_DESCRIPTOR_POOL:
+            vkDestroyDescriptorPool(context->device, deletion->as.descriptorPool, NULL);
+            break;
+    }
+}
+
+void deferDeletion(VulkanContext* context, VulkanDeletion deletion) {
+    VulkanDeletionQueue* queue = &context->deletionQueue;
+
+    if (queue->count == queue->capacity) {
+        uint32_t capacity = queue->capacity ? queue->capacity * 2 : 32;
+        VulkanDeletion* entries = realloc(queue->entries, sizeof(VulkanDeletion) * capacity);
+        if (!entries) {
+            // better stall than leak or destroy something the gpu still uses
+            fprintf(stderr, "Failed to grow deletion queue, destroying immediately!\n");
+            vkDeviceWaitIdle(context->device);
+            destroyDeletion(context, &deletion);
+            return;
+        }
+        queue->entries = entries;
+        queue->capacity = capacity;
+    }
+
+    queue->entries[queue->count++] = deletion;
+}
+
+void deferDestroyBuffer(VulkanContext* context, VulkanBuffer* buffer) {
+    VulkanDeletion deletion = { .type = VULKAN_DELETION_BUFFER, .retireValue = buffer->lastUse };
+    deletion.as.buffer = *buffer;
+    deferDeletion(context, deletion);
+    *buffer = (VulkanBuffer){0};
+}
+
+void deferDestroyImage(VulkanContext* context, VulkanImage* image) {
+    VulkanDeletion deletion = { .type = VULKAN_DELETION_IMAGE, .retireValue = image->lastUse };
+    deletion.as.image = *image;
+    deferDeletion(context, deletion);
+    *image = (VulkanImage){0};
+}
+
+void deferDestroyFramebuffer(VulkanContext* context, VkFramebuffer framebuffer, uint64_t retireValue) {
+    VulkanDeletion deletion = { .type = VULKAN_DELETION_FRAMEBUFFER, .retireValue = retireValue };
+    deletion.as.framebuffer = framebuffer;
+    deferDeletion(context, deletion);
+}
+
+void deferDestroyRenderPass(VulkanContext* context, VkRenderPass renderPass, uint64_t retireValue) {
+    VulkanDeletion deletion = { .type = VULKAN_DELETION_RENDER_PASS, .retireValue = retireValue };
+    deletion.as.renderPass = renderPass;
+    deferDeletion(context, deletion);
+}
+
+void deferDestroySwapchain(VulkanContext* context, VulkanSwapchain* swapchain, uint64_t retireValue) {
+    VulkanDeletion deletion = { .type = VULKAN_DELETION_SWAPCHAIN, .retireValue = retireValue };
+    deletion.as.swapchain = *swapchain;
+    deferDeletion(context, deletion);
+    *swapchain = (VulkanSwapchain){0};
+}
+
+void deferDestroyPipeline(VulkanContext* context, VulkanPipeline* pipeline, uint64_t retireValue) {
+    VulkanDeletion deletion = { .type = VULKAN_DELETION_PIPELINE, .retireValue = retireValue };
+    deletion.as.pipeline = *pipeline;
+    deferDeletion(context, deletion);
+    *pipeline = (VulkanPipeline){0};
+}
+
+void deferDestroyPipelineLayout(VulkanContext* context, VkPipelineLayout layout, uint64_t retireValue) {
+    VulkanDeletion deletion = { .type = VULKAN_DELETION_PIPELINE_LAYOUT, .retireValue = retireValue };
+    deletion.as.pipelineLayout = layout;
+    deferDeletion(context, deletion);
+}
+
+void deferDestroyDescriptorPool(VulkanContext* context, VkDescriptorPool descriptorPool, uint64_t retireValue) {
+    VulkanDeletion deletion = { .type = VULKAN_DELETION_DESCRIPTOR_POOL, .retireValue = retireValue };
+    deletion.as.descriptorPool = descriptorPool;
+    deferDeletion(context, deletion);
+}
+
+// Destroys everything whose retire value the graphics timeline has reached
+void flushDeletionQueue(VulkanContext* context) {
+    VulkanDeletionQueue* queue = &context->deletionQueue;
+    if (queue->count == 0) return;
+
+    uint64_t completedValue = getCompletedTimelineValue(context, &context->graphicsQueue);
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < queue->count; i++) {
+        if (queue->entries[i].retireValue <= completedValue) {
+            destroyDeletion(context, &queue->entries[i]);
+        }
+        else {
+            queue->entries[kept++] = queue->entries[i];
+        }
+    }
+    queue->count = kept;
+}
+
+// Only call once the device is idle
+void destroyDeletionQueue(VulkanContext* context) {
+    VulkanDeletionQueue* queue = &context->deletionQueue;
+    for (uint32_t i = 0; i < queue->count; i++) {
+        destroyDeletion(context, &queue->entries[i]);
+    }
+    free(queue->entries);
+    *queue = (VulkanDeletionQueue){0};
+}
@@ -0,0 +1,325 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vulkan/vulkan_core.h>
+
+#include "../include/vulkan_base.h"
+
+// Descriptors per set of each type a pool is created with
+static const VkDescriptorPoolSize poolRatios[] = {
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+};
+
+void destroyDescriptorAllocator(VulkanContext* context, VulkanDescriptorAllocator* allocator) {
+    for (uint32_t i = 0; i < allocator->poolCount; i++) {
+        vkDestroyDescriptorPool(context->device, allocator->pools[i], NULL);
+    }
+    free(allocator->pools);
+    *allocator = (VulkanDescriptorAllocator){0};
+}
+
+// All sets of the allocator become invalid, the gpu must be done with them
+void resetDescriptorAllocator(VulkanContext* context, VulkanDescriptorAllocator* allocator) {
+    // pools after currentPool were not used since the last reset
+    for (uint32_t i = 0; i <= allocator->currentPool && i < allocator->poolCount; i++) {
+        vkResetDescriptorPool(context->device, allocator->pools[i], 0);
+    }
+    allocator->currentPool = 0;
+}
+
+static bool addPool(VulkanContext* context, VulkanDescriptorAllocator* allocator) {
+    if (allocator->poolCount == allocator->poolCapacity) {
+        uint32_t capacity = allocator->poolCapacity ? allocator->poolCapacity * 2 : 4;
+        VkDescriptorPool* pools = realloc(allocator->pools, sizeof(VkDescriptorPool) * capacity);
+        if (!pools) {
+            fprintf(stderr, "Failed to grow descriptor pools!\n");
+            return false;
+        }
+        allocator->pools = pools;
+        allocator->poolCapacity = capacity;
+    }
+
+    if (!allocator->setsPerPool) {
+        allocator->setsPerPool = VULKAN_DESCRIPTOR_INITIAL_SETS_PER_POOL;
+    }
+
+    VkDescriptorPoolSize poolSizes[ARRAY_COUNT(poolRatios)];
+    for (uint32_t i = 0; i < ARRAY_COUNT(poolRatios); i++) {
+        poolSizes[i].type = poolRatios[i].type;
+        poolSizes[i].descriptorCount = poolRatios[i].descriptorCount * allocator->setsPerPool;
+    }
+
+    VkDescriptorPoolCreateInfo createInfo = {0};
+    createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    createInfo.maxSets = allocator->setsPerPool;
+    createInfo.poolSizeCount = ARRAY_COUNT(poolSizes);
+    createInfo.pPoolSizes = poolSizes;
+
+    if (vkCreateDescriptorPool(context->device, &createInfo, NULL, &allocator->pools[allocator->poolCount]) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create descriptorPool!\n");
+        return false;
+    }
+    allocator->poolCount++;
+
+    if (allocator->setsPerPool < VULKAN_DESCRIPTOR_MAX_SETS_PER_POOL) {
+        allocator->setsPerPool *= 2;
+    }
+    return true;
+}
+
+VkDescriptorSet allocateDescriptorSet(VulkanContext* context, VulkanDescriptorAllocator* allocator, VkDescriptorSetLayout layout) {
+    VkDescriptorSetAllocateInfo allocInfo = {0};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    for (;;) {
+        bool newPool = allocator->currentPool == allocator->poolCount;
+        if (newPool && !addPool(context, allocator)) {
+            return VK_NULL_HANDLE;
+        }
+
+        VkDescriptorSet set;
+        allocInfo.descriptorPool = allocator->pools[allocator->currentPool];
+        VkResult result = vkAllocateDescriptorSets(context->device, &allocInfo, &set);
+        if (result == VK_SUCCESS) {
+            return set;
+        }
+
+        // a full pool moves on to the next one, a fresh pool that is too small never fits the layout
+        if ((result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) || newPool) {
+            fprintf(stderr, "Failed to allocate descriptor set!\n");
+            return VK_NULL_HANDLE;
+        }
+        allocator->currentPool++;
+    }
+}
+
+static uint64_t hashBindings(const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingCount) {
+    uint64_t hash = VULKAN_HASH_SEED;
+    for (uint32_t i = 0; i < bindingCount; i++) {
+        const VkDescriptorSetLayoutBinding* binding = &bindings[i];
+        hash = hashBytes(hash, &binding->binding, sizeof(binding->binding));
+        hash = hashBytes(hash, &binding->descriptorType, sizeof(binding->descriptorType));
+        hash = hashBytes(hash, &binding->descriptorCount, sizeof(binding->descriptorCount));
+        hash = hashBytes(hash, &binding->stageFlags, sizeof(binding->stageFlags));
+        if (binding->pImmutableSamplers) {
+            hash = hashBytes(hash, binding->pImmutableSamplers, sizeof(VkSampler) * binding->descriptorCount);
+        }
+    }
+    return hash;
+}
+
+static bool bindingsEqual(const VkDescriptorSetLayoutBinding* a, const VkDescriptorSetLayoutBinding* b, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (a[i].binding != b[i].binding || a[i].descriptorType != b[i].descriptorType ||
+            a[i].descriptorCount != b[i].descriptorCount || a[i].stageFlags != b[i].stageFlags ||
+            !a[i].pImmutableSamplers != !b[i].pImmutableSamplers) {
+            return false;
+        }
+        if (a[i].pImmutableSamplers &&
+            memcmp(a[i].pImmutableSamplers, b[i].pImmutableSamplers, sizeof(VkSampler) * a[i].descriptorCount) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool growLayoutCache(VulkanDescriptorLayoutCache* cache) {
+    uint32_t capacity = cache->capacity ? cache->capacity * 2 : 16;
+    VulkanDescriptorLayoutEntry* entries = calloc(capacity, sizeof(VulkanDescriptorLayoutEntry));
+    if (!entries) {
+        fprintf(stderr, "Failed to grow descriptor layout cache!\n");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < cache->capacity; i++) {
+        VulkanDescriptorLayoutEntry* entry = &cache->entries[i];
+        if (!entry->layout) continue;
+
+        uint32_t slot = (uint32_t)entry->hash & (capacity - 1);
+        while (entries[slot].layout) slot = (slot + 1) & (capacity - 1);
+        entries[slot] = *entry;
+    }
+
+    free(cache->entries);
+    cache->entries = entries;
+    cache->capacity = capacity;
+    return true;
+}
+
+// Returns the layout for the bindings, created on first use. The layouts are owned by the
+// cache and destroyed with the context.
+VkDescriptorSetLayout getDescriptorSetLayout(VulkanContext* context, const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingCount) {
+    VulkanDescriptorLayoutCache* cache = &context->descriptorLayoutCache;
+
+    // the order of the bindings does not matter to vulkan, sort them so it does not matter to the hash
+    VkDescriptorSetLayoutBinding* sorted = malloc(sizeof(VkDescriptorSetLayoutBinding) * (bindingCount + 1));
+    if (!sorted) {
+        fprintf(stderr, "Failed to allocate descriptor layout bindings!\n");
+        return VK_NULL_HANDLE;
+    }
+    for (uint32_t i = 0; i < bindingCount; i++) {
+        VkDescriptorSetLayoutBinding binding = bindings[i];
+        uint32_t j = i;
+        for (; j > 0 && sorted[j - 1].binding > binding.binding; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = binding;
+    }
+
+    uint64_t hash = hashBindings(sorted, bindingCount);
+
+    if (cache->capacity) {
+        uint32_t slot = (uint32_t)hash & (cache->capacity - 1);
+        for (; cache->entries[slot].layout; slot = (slot + 1) & (cache->capacity - 1)) {
+            VulkanDescriptorLayoutEntry* entry = &cache->entries[slot];
+            if (entry->hash == hash && entry->bindingCount == bindingCount && bindingsEqual(entry->bindings, sorted, bindingCount)) {
+                free(sorted);
+                return entry->layout;
+            }
+        }
+    }
+
+    // keep the load factor under 1/2
+    if ((cache->count + 1) * 2 > cache->capacity && !growLayoutCache(cache)) {
+        free(sorted);
+        return VK_NULL_HANDLE;
+    }
+
+    // the caller's immutable sampler arrays may not outlive the call
+    uint32_t samplerCount = 0;
+    for (uint32_t i = 0; i < bindingCount; i++) {
+        if (sorted[i].pImmutableSamplers) samplerCount += sorted[i].descriptorCount;
+    }
+    VkSampler* samplers = NULL;
+    if (samplerCount) {
+        samplers = malloc(sizeof(VkSampler) * samplerCount);
+        if (!samplers) {
+            fprintf(stderr, "Failed to allocate immutable samplers!\n");
+            free(sorted);
+            return VK_NULL_HANDLE;
+        }
+        VkSampler* next = samplers;
+        for (uint32_t i = 0; i < bindingCount; i++) {
+            if (!sorted[i].pImmutableSamplers) continue;
+            memcpy(next, sorted[i].pImmutableSamplers, sizeof(VkSampler) * sorted[i].descriptorCount);
+            sorted[i].pImmutableSamplers = next;
+            next += sorted[i].descriptorCount;
+        }
+    }
+
+    VkDescriptorSetLayoutCreateInfo createInfo = {0};
+    createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    createInfo.bindingCount = bindingCount;
+    createInfo.pBindings = sorted;
+
+    VkDescriptorSetLayout layout;
+    if (vkCreateDescriptorSetLayout(context->device, &createInfo, NULL, &layout) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create descriptor layout!\n");
+        free(samplers);
+        free(sorted);
+        return VK_NULL_HANDLE;
+    }
+
+    uint32_t slot = (uint32_t)hash & (cache->capacity - 1);
+    while (cache->entries[slot].layout) slot = (slot + 1) & (cache->capacity - 1);
+
+    VulkanDescriptorLayoutEntry* entry = &cache->entries[slot];
+    entry->hash = hash;
+    entry->bindingCount = bindingCount;
+    entry->bindings = sorted;
+    entry->layout = layout;
+    cache->count++;
+
+    return layout;
+}
+
+// Template writing every descriptor of a layout from the cache, the data is an array of
+// VulkanDescriptorInfo. Created once per layout and owned by the cache.
+VkDescriptorUpdateTemplate getDescriptorUpdateTemplate(VulkanContext* context, VkDescriptorSetLayout layout) {
+    VulkanDescriptorLayoutCache* cache = &context->descriptorLayoutCache;
+
+    VulkanDescriptorLayoutEntry* entry = NULL;
+    for (uint32_t i = 0; i < cache->capacity; i++) {
+        if (cache->entries[i].layout == layout) {
+            entry = &cache->entries[i];
+            break;
+        }
+    }
+    if (!entry) {
+        fprintf(stderr, "Descriptor layout is not from the layout cache!\n");
+        return VK_NULL_HANDLE;
+    }
+    if (entry->updateTemplate) {
+        return entry->updateTemplate;
+    }
+
+    VkDescriptorUpdateTemplateEntry* templateEntries = malloc(sizeof(VkDescriptorUpdateTemplateEntry) * (entry->bindingCount + 1));
+    if (!templateEntries) {
+        fprintf(stderr, "Failed to allocate descriptor update template entries!\n");
+        return VK_NULL_HANDLE;
+    }
+
+    // immutable samplers are written too, the sampler of their image info is ignored
+    uint32_t entryCount = 0;
+    size_t offset = 0;
+    for (uint32_t i = 0; i < entry->bindingCount; i++) {
+        VkDescriptorSetLayoutBinding* binding = &entry->bindings[i];
+        if (binding->descriptorCount == 0) continue;
+
+        VkDescriptorUpdateTemplateEntry* templateEntry = &templateEntries[entryCount++];
+        templateEntry->dstBinding = binding->binding;
+        templateEntry->dstArrayElement = 0;
+        templateEntry->descriptorCount = binding->descriptorCount;
+        templateEntry->descriptorType = binding->descriptorType;
+        templateEntry->offset = offset;
+        templateEntry->stride = sizeof(VulkanDescriptorInfo);
+        offset += sizeof(VulkanDescriptorInfo) * binding->descriptorCount;
+    }
+
+    VkDescriptorUpdateTemplateCreateInfo createInfo = {0};
+    createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    createInfo.descriptorUpdateEntryCount = entryCount;
+    createInfo.pDescriptorUpdateEntries = templateEntries;
+    createInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+    createInfo.descriptorSetLayout = layout;
+
+    if (vkCreateDescriptorUpdateTemplate(context->device, &createInfo, NULL, &entry->updateTemplate) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create descriptor update template!\n");
+        entry->updateTemplate = VK_NULL_HANDLE;
+    }
+    free(templateEntries);
+
+    return entry->updateTemplate;
+}
+
+void destroyDescriptorLayoutCache(VulkanContext* context) {
+    VulkanDescriptorLayoutCache* cache = &context->descriptorLayoutCache;
+    for (uint32_t i = 0; i < cache->capacity; i++) {
+        VulkanDescriptorLayoutEntry* entry = &cache->entries[i];
+        if (!entry->layout) continue;
+
+        if (entry->updateTemplate) {
+            vkDestroyDescriptorUpdateTemplate(context->device, entry->updateTemplate, NULL);
+        }
+        vkDestroyDescriptorSetLayout(context->device, entry->layout, NULL);
+        // the immutable samplers of all bindings are one allocation, starting at the first binding that has some
+        for (uint32_t j = 0; j < entry->bindingCount; j++) {
+            if (entry->bindings[j].pImmutableSamplers) {
+                free((void*)entry->bindings[j].pImmutableSamplers);
+                break;
+            }
+        }
+        free(entry->bindings);
+    }
+    free(cache->entries);
+    *cache = (VulkanDescriptorLayoutCache){0};
+}
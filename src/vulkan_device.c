@@ -1,6 +1,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "../include/vulkan_base.h"
 
@@ -50,6 +51,34 @@ VkDebugUtilsMessengerEXT registerDebugCallback(VkInstance instance) {
     return callback;
 }
 
+static bool hasDeviceExtension(VkExtensionProperties* extensions, uint32_t numExtensions, const char* name) {
+    for (uint32_t i = 0; i < numExtensions; i++) {
+        if (strcmp(extensions[i].extensionName, name) == 0) return true;
+    }
+    return false;
+}
+
+// Calibration is only useful if the gpu clock can be correlated with the clock the cpu side uses
+static bool supportsMonotonicCalibration(VulkanContext* context) {
+    PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT getTimeDomains = (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)
+        vkGetInstanceProcAddr(context->instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+    if (!getTimeDomains) return false;
+
+    uint32_t numTimeDomains = 0;
+    getTimeDomains(context->physicalDevice, &numTimeDomains, NULL);
+    VkTimeDomainEXT timeDomains[8];
+    if (numTimeDomains > ARRAY_COUNT(timeDomains)) numTimeDomains = ARRAY_COUNT(timeDomains);
+    getTimeDomains(context->physicalDevice, &numTimeDomains, timeDomains);
+
+    bool hasDevice = false;
+    bool hasMonotonic = false;
+    for (uint32_t i = 0; i < numTimeDomains; i++) {
+        if (timeDomains[i] == VK_TIME_DOMAIN_DEVICE_EXT) hasDevice = true;
+        if (timeDomains[i] == VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT) hasMonotonic = true;
+    }
+    return hasDevice && hasMonotonic;
+}
+
 bool createLogicalDevice(VulkanContext *context, uint32_t deviceExtensionCount, const char** deviceExtensions) {
     
     // Queues
@@ -73,16 +102,104 @@ bool createLogicalDevice(VulkanContext *context, uint32_t deviceExtensionCount,
     float priorities[] = { 1.0f };
     VkDeviceQueueCreateInfo queueCreateInfo = {0};
     queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueCreateInfo.queueFamilyIndex = graphicsQueueIndex;
     queueCreateInfo.queueCount = 1;
     queueCreateInfo.pQueuePriorities = priorities;
 
+    // Optional extensions are enabled on top of the required ones when available
+    uint32_t numAvailableExtensions = 0;
+    vkEnumerateDeviceExtensionProperties(context->physicalDevice, NULL, &numAvailableExtensions, NULL);
+    VkExtensionProperties* availableExtensions = malloc(sizeof(VkExtensionProperties) * numAvailableExtensions);
+    const char** enabledExtensions = malloc(sizeof(char*) * (deviceExtensionCount + MAX_OPTIONAL_DEVICE_EXTENSIONS));
+    if (!availableExtensions || !enabledExtensions) {
+        fprintf(stderr, "Failed to allocate memory for device extensions!\n");
+        return false;
+    }
+    vkEnumerateDeviceExtensionProperties(context->physicalDevice, NULL, &numAvailableExtensions, availableExtensions);
+
+    uint32_t enabledExtensionCount = 0;
+    for (uint32_t i = 0; i < deviceExtensionCount; i++) {
+        enabledExtensions[enabledExtensionCount++] = deviceExtensions[i];
+    }
+
+    // extension feature structs may only be chained when the extension exists
+    bool hasDynamicRendering = hasDeviceExtension(availableExtensions, numAvailableExtensions, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR supportedDynamicRendering = {0};
+    supportedDynamicRendering.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+    VkPhysicalDeviceVulkan12Features supportedFeatures12 = {0};
+    supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    supportedFeatures12.pNext = hasDynamicRendering ? &supportedDynamicRendering : NULL;
+
+    VkPhysicalDeviceFeatures2 supportedFeatures = {0};
+    supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures.pNext = &supportedFeatures12;
+    vkGetPhysicalDeviceFeatures2(context->physicalDevice, &supportedFeatures);
+
+    if (!supportedFeatures12.timelineSemaphore) {
+        fprintf(stderr, "Device does not support timeline semaphores!\n");
+        return false;
+    }
+
+    VkPhysicalDeviceVulkan12Features enabledFeatures12 = {0};
+    enabledFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    enabledFeatures12.timelineSemaphore = VK_TRUE;
+
+    // bindless textures: a partially bound, update after bind array indexed per draw
+    if (supportedFeatures12.descriptorIndexing &&
+        supportedFeatures12.runtimeDescriptorArray &&
+        supportedFeatures12.descriptorBindingPartiallyBound &&
+        supportedFeatures12.descriptorBindingSampledImageUpdateAfterBind &&
+        supportedFeatures12.descriptorBindingStorageBufferUpdateAfterBind &&
+        supportedFeatures12.descriptorBindingUpdateUnusedWhilePending &&
+        supportedFeatures12.shaderSampledImageArrayNonUniformIndexing) {
+        enabledFeatures12.descriptorIndexing = VK_TRUE;
+        enabledFeatures12.runtimeDescriptorArray = VK_TRUE;
+        enabledFeatures12.descriptorBindingPartiallyBound = VK_TRUE;
+        enabledFeatures12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        enabledFeatures12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        enabledFeatures12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        enabledFeatures12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        context->supportsDescriptorIndexing = true;
+    }
+
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR enabledDynamicRendering = {0};
+    enabledDynamicRendering.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+    // core in 1.3, we request 1.2 so go through the extension
+    if (hasDynamicRendering && supportedDynamicRendering.dynamicRendering) {
+        enabledExtensions[enabledExtensionCount++] = VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME;
+        enabledDynamicRendering.dynamicRendering = VK_TRUE;
+        enabledFeatures12.pNext = &enabledDynamicRendering;
+        context->supportsDynamicRendering = true;
+    }
+
+    if (hasDeviceExtension(availableExtensions, numAvailableExtensions, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) &&
+        supportsMonotonicCalibration(context)) {
+        enabledExtensions[enabledExtensionCount++] = VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME;
+        context->supportsCalibratedTimestamps = true;
+    }
+
+    if (hasDeviceExtension(availableExtensions, numAvailableExtensions, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+        enabledExtensions[enabledExtensionCount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+        context->supportsMemoryBudget = true;
+    }
+
     VkPhysicalDeviceFeatures enabledFeatures = {0};
 
+    // anisotropic filtering, optional, getSampler falls back to plain filtering
+    if (supportedFeatures.features.samplerAnisotropy) {
+        enabledFeatures.samplerAnisotropy = VK_TRUE;
+        context->supportsSamplerAnisotropy = true;
+    }
+
     VkDeviceCreateInfo createInfo = {0};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &enabledFeatures12;
     createInfo.pEnabledFeatures = &enabledFeatures;
-    createInfo.enabledExtensionCount = deviceExtensionCount;
-    createInfo.ppEnabledExtensionNames = deviceExtensions;
+    createInfo.enabledExtensionCount = enabledExtensionCount;
+    createInfo.ppEnabledExtensionNames = enabledExtensions;
     createInfo.queueCreateInfoCount = 1;
     createInfo.pQueueCreateInfos = &queueCreateInfo;
     
@@ -91,21 +208,35 @@ bool createLogicalDevice(VulkanContext *context, uint32_t deviceExtensionCount,
         return false;
     }
 
+    free(availableExtensions);
+    free(enabledExtensions);
+
+    if (context->supportsDynamicRendering) {
+        context->cmdBeginRendering = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(context->device, "vkCmdBeginRenderingKHR");
+        context->cmdEndRendering = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(context->device, "vkCmdEndRenderingKHR");
+    }
+    if (context->supportsCalibratedTimestamps) {
+        context->getCalibratedTimestamps = (PFN_vkGetCalibratedTimestampsEXT)vkGetDeviceProcAddr(context->device, "vkGetCalibratedTimestampsEXT");
+    }
+
     // Acquire queues
     context->graphicsQueue.familyIndex = graphicsQueueIndex;
     vkGetDeviceQueue(context->device, graphicsQueueIndex, 0, &context->graphicsQueue.queue);
+    if (!createQueueTimeline(context, &context->graphicsQueue)) {
+        return false;
+    }
 
-    VkPhysicalDeviceMemoryProperties deviceMemoryProperties = {0};
-    vkGetPhysicalDeviceMemoryProperties(context->physicalDevice, &deviceMemoryProperties);
-    printf("Device memory heaps count: %d\n", deviceMemoryProperties.memoryHeapCount);
-    for (uint32_t i = 0; i < deviceMemoryProperties.memoryHeapCount; i++) {
-        const char* isDeviceLocal = "false";
-        if (deviceMemoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
-            isDeviceLocal = "true";
-        }
-        printf("Heap %d: Size (bytes): %ld Device local: %s\n", i, deviceMemoryProperties.memoryHeaps[i].size, isDeviceLocal);
+    // in memory only, it keeps the driver from compiling the same shader stages twice
+    VkPipelineCacheCreateInfo pipelineCacheInfo = {0};
+    pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    if (vkCreatePipelineCache(context->device, &pipelineCacheInfo, NULL, &context->pipelineCache) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create pipeline cache!\n");
+        context->pipelineCache = VK_NULL_HANDLE;
     }
 
+    initMemoryTracker(context);
+    printMemorySnapshot(context, stdout);
+
     return true;
 }
 
@@ -145,7 +276,7 @@ bool selectPhysicalDevice(VulkanContext *context) {
     return true;
 }
 
-bool initVulkanInstance(VulkanContext* context, uint32_t instanceExtensionCount, const char** instanceExtensions) {
+bool initVulkanInstance(VulkanContext* context, uint32_t instanceExtensionCount, const char** instanceExtensions, bool enableValidation) {
 
     // get layers
     uint32_t layerCount = 0;
@@ -163,7 +294,7 @@ bool initVulkanInstance(VulkanContext* context, uint32_t instanceExtensionCount,
     };
     
     // check if we have the layer
-    for (uint32_t i = 0; i < ARRAY_COUNT(enabledLayers); i++) {
+    for (uint32_t i = 0; enableValidation && i < ARRAY_COUNT(enabledLayers); i++) {
         bool found = false;
         for (uint32_t j = 0; j < layerCount; j++) {
             if (memcmp(enabledLayers[i], layerProperties[j].layerName, strlen(layerProperties[j].layerName)) == 0) {
@@ -200,10 +331,10 @@ bool initVulkanInstance(VulkanContext* context, uint32_t instanceExtensionCount,
 
     VkInstanceCreateInfo createInfo = {0};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-    createInfo.pNext = &validationFeatures;
+    createInfo.pNext = enableValidation ? &validationFeatures : NULL;
     createInfo.pApplicationInfo = &appInfo;
 
-    createInfo.enabledLayerCount = ARRAY_COUNT(enabledLayers);
+    createInfo.enabledLayerCount = enableValidation ? ARRAY_COUNT(enabledLayers) : 0;
     createInfo.ppEnabledLayerNames = enabledLayers;
     createInfo.enabledExtensionCount = instanceExtensionCount;
     createInfo.ppEnabledExtensionNames = instanceExtensions;
@@ -213,19 +344,21 @@ bool initVulkanInstance(VulkanContext* context, uint32_t instanceExtensionCount,
         return false;
     }
 
-    context->debugCallback = registerDebugCallback(context->instance);
+    if (enableValidation) {
+        context->debugCallback = registerDebugCallback(context->instance);
+    }
 
     return true;
 }
 
-VulkanContext* initVulkan(uint32_t glfwExtensionCount, const char** glfwExtensions, uint32_t deviceExtensionCount, const char** deviceExtensions) {
-    VulkanContext* context = malloc(sizeof(VulkanContext));
+VulkanContext* initVulkan(uint32_t glfwExtensionCount, const char** glfwExtensions, uint32_t deviceExtensionCount, const char** deviceExtensions, bool enableValidation) {
+    VulkanContext* context = calloc(1, sizeof(VulkanContext));
     if (!context) {
         fprintf(stderr, "Failed to allocate memory for vulkan context!\n");
         return NULL;
     }
 
-    if (!initVulkanInstance(context, glfwExtensionCount, glfwExtensions)) return NULL;
+    if (!initVulkanInstance(context, glfwExtensionCount, glfwExtensions, enableValidation)) return NULL;
     if (!selectPhysicalDevice(context)) return NULL;
     if (!createLogicalDevice(context, deviceExtensionCount, deviceExtensions)) return NULL;
 
@@ -236,6 +369,13 @@ VulkanContext* initVulkan(uint32_t glfwExtensionCount, const char** glfwExtensio
 void exitVulkan(VulkanContext *context) {
     // wait for graphics crad to finish work
     vkDeviceWaitIdle(context->device);
+    destroyDeletionQueue(context);
+    destroyResourcePools(context);
+    destroyPipelineRegistry(context);
+    destroySamplerCache(context);
+    destroyDescriptorLayoutCache(context);
+    vkDestroyPipelineCache(context->device, context->pipelineCache, NULL);
+    destroyQueueTimeline(context, &context->graphicsQueue);
     vkDestroyDevice(context->device, NULL);
     
     if (context->debugCallback) {
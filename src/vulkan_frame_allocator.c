@@ -0,0 +1,108 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan_core.h>
+
+#include "../include/vulkan_base.h"
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Memory types a buffer with this size and usage may be bound to, 0 if it can't be created
+static uint32_t getBufferMemoryTypeBits(VulkanContext* context, VkDeviceSize size, VkBufferUsageFlags usage) {
+    VkBufferCreateInfo createInfo = {0};
+    createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    createInfo.size = size;
+    createInfo.usage = usage;
+
+    VkBuffer buffer;
+    if (vkCreateBuffer(context->device, &createInfo, NULL, &buffer) != VK_SUCCESS) {
+        return 0;
+    }
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(context->device, buffer, &memoryRequirements);
+    vkDestroyBuffer(context->device, buffer, NULL);
+    return memoryRequirements.memoryTypeBits;
+}
+
+bool createFrameAllocator(VulkanContext* context, VulkanFrameAllocator* allocator, VkDeviceSize frameSize, uint32_t frameCount) {
+    *allocator = (VulkanFrameAllocator){0};
+
+    VkPhysicalDeviceLimits* limits = &context->physicalDeviceProperties.limits;
+    allocator->alignment = limits->minUniformBufferOffsetAlignment;
+    if (limits->minStorageBufferOffsetAlignment > allocator->alignment) {
+        allocator->alignment = limits->minStorageBufferOffsetAlignment;
+    }
+    if (allocator->alignment < 16) allocator->alignment = 16;
+
+    // every region starts aligned, dynamic offsets are 32 bit
+    allocator->frameSize = alignUp(frameSize, allocator->alignment);
+    allocator->frameCount = frameCount;
+    if (allocator->frameSize * frameCount > UINT32_MAX) {
+        fprintf(stderr, "Frame allocator of %lu bytes is too large for dynamic offsets!\n", allocator->frameSize * frameCount);
+        return false;
+    }
+
+    VkDeviceSize size = allocator->frameSize * frameCount;
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                               VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+
+    // device local host visible memory (resizable bar, integrated gpus) lets the gpu read
+    // the data without going over the bus, otherwise plain host memory is used. Only types
+    // the buffer may be bound to count, the device local ones can exclude some usages.
+    VkMemoryPropertyFlags memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    if (hasMemoryType(context, getBufferMemoryTypeBits(context, size, usage), memoryProperties | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+        memoryProperties |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    }
+
+    createBuffer(context, &allocator->buffer, size, usage, memoryProperties, VULKAN_MEMORY_UNIFORM);
+    if (!allocator->buffer.memory) {
+        return false;
+    }
+
+    void* mapped;
+    if (vkMapMemory(context->device, allocator->buffer.memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to map frame allocator!\n");
+        destroyBuffer(context, &allocator->buffer);
+        return false;
+    }
+    allocator->mapped = mapped;
+
+    return true;
+}
+
+void destroyFrameAllocator(VulkanContext* context, VulkanFrameAllocator* allocator) {
+    if (!allocator->buffer.memory) return;
+
+    vkUnmapMemory(context->device, allocator->buffer.memory);
+    destroyBuffer(context, &allocator->buffer);
+    *allocator = (VulkanFrameAllocator){0};
+}
+
+// Only valid once the frame slot's previous submission finished, it overwrites its data
+void beginFrameAllocator(VulkanFrameAllocator* allocator, uint32_t frameIndex) {
+    allocator->frameBase = allocator->frameSize * frameIndex;
+    allocator->used = 0;
+}
+
+// Returns the memory to write the data to and its offset in the buffer, for a dynamic offset or
+// a vertex/index buffer binding. Returns NULL if the frame's region is full.
+void* frameAllocate(VulkanFrameAllocator* allocator, VkDeviceSize size, uint32_t* offset) {
+    VkDeviceSize start = alignUp(allocator->used, allocator->alignment);
+    if (start + size > allocator->frameSize) {
+        if (!allocator->overflowed) {
+            fprintf(stderr, "Frame allocator out of memory (%lu of %lu bytes used)!\n", allocator->used, allocator->frameSize);
+            allocator->overflowed = true;
+        }
+        return NULL;
+    }
+
+    allocator->used = start + size;
+    if (allocator->used > allocator->peakUsed) allocator->peakUsed = allocator->used;
+
+    *offset = (uint32_t)(allocator->frameBase + start);
+    return allocator->mapped + allocator->frameBase + start;
+}
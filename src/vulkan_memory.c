@@ -0,0 +1,150 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vulkan/vulkan_core.h>
+
+#include "../include/vulkan_base.h"
+
+// warn once a heap's usage passes this part of its budget, and again after it dropped below the reset
+#define MEMORY_BUDGET_WARNING 0.9
+#define MEMORY_BUDGET_WARNING_RESET 0.8
+
+static const char* categoryNames[VULKAN_MEMORY_CATEGORY_COUNT] = {
+    "geometry",
+    "textures",
+    "render targets",
+    "staging",
+    "uniforms",
+};
+
+const char* memoryCategoryName(VulkanMemoryCategory category) {
+    return category < VULKAN_MEMORY_CATEGORY_COUNT ? categoryNames[category] : "unknown";
+}
+
+void initMemoryTracker(VulkanContext* context) {
+    VulkanMemoryTracker* tracker = &context->memoryTracker;
+    memset(tracker, 0, sizeof(*tracker));
+    vkGetPhysicalDeviceMemoryProperties(context->physicalDevice, &tracker->memoryProperties);
+}
+
+// Budget and usage of every heap, usage includes other apis and allocations we do not track.
+// Without VK_EXT_memory_budget the heap size and our own allocations are the best we know.
+static bool queryHeapBudgets(VulkanContext* context, VkDeviceSize* budgets, VkDeviceSize* usages) {
+    VulkanMemoryTracker* tracker = &context->memoryTracker;
+
+    if (!context->supportsMemoryBudget) {
+        for (uint32_t i = 0; i < tracker->memoryProperties.memoryHeapCount; i++) {
+            budgets[i] = tracker->memoryProperties.memoryHeaps[i].size;
+            usages[i] = tracker->heapBytes[i];
+        }
+        return false;
+    }
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {0};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2 memoryProperties = {0};
+    memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memoryProperties.pNext = &budgetProperties;
+    vkGetPhysicalDeviceMemoryProperties2(context->physicalDevice, &memoryProperties);
+
+    for (uint32_t i = 0; i < tracker->memoryProperties.memoryHeapCount; i++) {
+        budgets[i] = budgetProperties.heapBudget[i];
+        usages[i] = budgetProperties.heapUsage[i];
+    }
+    return true;
+}
+
+static void checkBudget(VulkanContext* context, uint32_t heapIndex) {
+    VulkanMemoryTracker* tracker = &context->memoryTracker;
+
+    VkDeviceSize budgets[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize usages[VK_MAX_MEMORY_HEAPS];
+    queryHeapBudgets(context, budgets, usages);
+    if (budgets[heapIndex] == 0) return;
+
+    double used = (double)usages[heapIndex] / (double)budgets[heapIndex];
+    if (used >= MEMORY_BUDGET_WARNING && !tracker->heapWarned[heapIndex]) {
+        tracker->heapWarned[heapIndex] = true;
+        fprintf(stderr, "Memory heap %u at %.0f%% of its budget (%.1f of %.1f MiB)!\n", heapIndex, used * 100.0,
+                (double)usages[heapIndex] / (1024.0 * 1024.0), (double)budgets[heapIndex] / (1024.0 * 1024.0));
+        printMemorySnapshot(context, stderr);
+    }
+    else if (used < MEMORY_BUDGET_WARNING_RESET) {
+        tracker->heapWarned[heapIndex] = false;
+    }
+}
+
+void trackAllocation(VulkanContext* context, VulkanAllocationInfo* allocation) {
+    VulkanMemoryTracker* tracker = &context->memoryTracker;
+    uint32_t heapIndex = tracker->memoryProperties.memoryTypes[allocation->memoryTypeIndex].heapIndex;
+
+    tracker->bytes[allocation->category] += allocation->size;
+    tracker->allocations[allocation->category]++;
+    if (tracker->bytes[allocation->category] > tracker->peakBytes[allocation->category]) {
+        tracker->peakBytes[allocation->category] = tracker->bytes[allocation->category];
+    }
+    tracker->heapBytes[heapIndex] += allocation->size;
+
+    checkBudget(context, heapIndex);
+}
+
+void untrackAllocation(VulkanContext* context, VulkanAllocationInfo* allocation) {
+    VulkanMemoryTracker* tracker = &context->memoryTracker;
+    uint32_t heapIndex = tracker->memoryProperties.memoryTypes[allocation->memoryTypeIndex].heapIndex;
+
+    tracker->bytes[allocation->category] -= allocation->size;
+    tracker->allocations[allocation->category]--;
+    tracker->heapBytes[heapIndex] -= allocation->size;
+    allocation->size = 0;
+}
+
+void getMemorySnapshot(VulkanContext* context, VulkanMemorySnapshot* snapshot) {
+    VulkanMemoryTracker* tracker = &context->memoryTracker;
+    memset(snapshot, 0, sizeof(*snapshot));
+
+    memcpy(snapshot->categoryBytes, tracker->bytes, sizeof(tracker->bytes));
+    memcpy(snapshot->categoryPeakBytes, tracker->peakBytes, sizeof(tracker->peakBytes));
+    memcpy(snapshot->categoryAllocations, tracker->allocations, sizeof(tracker->allocations));
+
+    VkDeviceSize budgets[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize usages[VK_MAX_MEMORY_HEAPS];
+    snapshot->hasBudget = queryHeapBudgets(context, budgets, usages);
+
+    snapshot->heapCount = tracker->memoryProperties.memoryHeapCount;
+    for (uint32_t i = 0; i < snapshot->heapCount; i++) {
+        VulkanHeapSnapshot* heap = &snapshot->heaps[i];
+        heap->size = tracker->memoryProperties.memoryHeaps[i].size;
+        heap->budget = budgets[i];
+        heap->usage = usages[i];
+        heap->allocated = tracker->heapBytes[i];
+        heap->deviceLocal = (tracker->memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+}
+
+static double toMiB(VkDeviceSize bytes) {
+    return (double)bytes / (1024.0 * 1024.0);
+}
+
+void printMemorySnapshot(VulkanContext* context, FILE* file) {
+    VulkanMemorySnapshot snapshot;
+    getMemorySnapshot(context, &snapshot);
+
+    fprintf(file, "%-16s %8s %10s %10s\n", "memory (MiB)", "allocs", "used", "peak");
+    for (uint32_t i = 0; i < VULKAN_MEMORY_CATEGORY_COUNT; i++) {
+        fprintf(file, "%-16s %8u %10.2f %10.2f\n", memoryCategoryName(i), snapshot.categoryAllocations[i],
+                toMiB(snapshot.categoryBytes[i]), toMiB(snapshot.categoryPeakBytes[i]));
+    }
+
+    if (!snapshot.hasBudget) {
+        fprintf(file, "no VK_EXT_memory_budget, heap usage only counts our own allocations\n");
+    }
+    for (uint32_t i = 0; i < snapshot.heapCount; i++) {
+        VulkanHeapSnapshot* heap = &snapshot.heaps[i];
+        fprintf(file, "heap %u%s: used %.2f, budget %.2f, size %.2f, allocated here %.2f MiB\n", i,
+                heap->deviceLocal ? " (device local)" : "", toMiB(heap->usage), toMiB(heap->budget),
+                toMiB(heap->size), toMiB(heap->allocated));
+    }
+}
@@ -1,5 +1,6 @@
 
 #include <stdio.h> 
+#include <string.h>
 #include <stdlib.h>
 #include <time.h>
 #include <vulkan/vulkan_core.h>
@@ -50,14 +51,39 @@ VkShaderModule createShaderModule(VulkanContext *context, const char *filepath)
     return result;
 }
 
-VulkanPipeline createPipeline(VulkanContext *context, const char *vertPath, const char *fragPath,
-        VkRenderPass renderPass, uint32_t width, uint32_t height,
-        VkVertexInputAttributeDescription* attributes, uint32_t numAttributes,
-        VkVertexInputBindingDescription* binding, uint32_t numSetLayouts,
-        VkDescriptorSetLayout* setLayouts, VkPushConstantRange* pushConstant) {
+VulkanPipelineDesc defaultPipelineDesc(void) {
+    VulkanPipelineDesc desc = {0};
+    desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    desc.polygonMode = VK_POLYGON_MODE_FILL;
+    desc.cullMode = VK_CULL_MODE_BACK_BIT;
+    desc.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    desc.depthTest = true;
+    desc.depthWrite = true;
+    desc.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL; // inverse z, see getProjectionInverseZ
+    desc.blend = VULKAN_BLEND_NONE;
+    desc.formats.sampleCount = VK_SAMPLE_COUNT_1_BIT;
+    return desc;
+}
+
+// per draw data in push constants starts at offset 0 and replaces the caller's range
+static const VkPushConstantRange* getPushConstantRange(const VulkanPipelineDesc* desc, VkPushConstantRange* drawDataRange) {
+    if (desc->drawData && desc->drawData->pushConstants) {
+        if (desc->pushConstant) {
+            fprintf(stderr, "Pipeline with push constants and per draw data in push constants!\n");
+            exit(-1);
+        }
+        *drawDataRange = (VkPushConstantRange){0};
+        drawDataRange->stageFlags = desc->drawData->stages;
+        drawDataRange->offset = 0;
+        drawDataRange->size = desc->drawData->size;
+        return drawDataRange;
+    }
+    return desc->pushConstant;
+}
 
-    VkShaderModule vertexShaderModule = createShaderModule(context, vertPath);
-    VkShaderModule fragmentShaderModule = createShaderModule(context, fragPath);
+static VulkanPipeline createPipeline(VulkanContext* context, const VulkanPipelineDesc* desc, VkPipelineLayout pipelineLayout) {
+    VkShaderModule vertexShaderModule = createShaderModule(context, desc->vertPath);
+    VkShaderModule fragmentShaderModule = createShaderModule(context, desc->fragPath);
 
     VkPipelineShaderStageCreateInfo shaderStages[2];
     shaderStages[0] = (VkPipelineShaderStageCreateInfo){0};
@@ -71,56 +97,57 @@ VulkanPipeline createPipeline(VulkanContext *context, const char *vertPath, cons
     shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     shaderStages[1].module = fragmentShaderModule;
     shaderStages[1].pName = "main";
+    shaderStages[1].pSpecializationInfo = desc->fragSpecialization;
 
     VkPipelineVertexInputStateCreateInfo vertexInputState = {0};
     vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-    vertexInputState.vertexAttributeDescriptionCount = numAttributes;
-    vertexInputState.pVertexAttributeDescriptions = attributes;
-    vertexInputState.vertexBindingDescriptionCount = binding ? 1 : 0;
-    vertexInputState.pVertexBindingDescriptions = binding;
+    vertexInputState.vertexAttributeDescriptionCount = desc->attributeCount;
+    vertexInputState.pVertexAttributeDescriptions = desc->attributes;
+    vertexInputState.vertexBindingDescriptionCount = desc->binding ? 1 : 0;
+    vertexInputState.pVertexBindingDescriptions = desc->binding;
 
     VkPipelineInputAssemblyStateCreateInfo inpuAssemblyState = {0};
     inpuAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inpuAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-   
-    // Depricated because of dynamicStates
-    //VkViewport viewport = (VkViewport){0.0f, 0.0f, (float)width, (float)(height)};
-    //VkRect2D scissor = (VkRect2D){{0, 0}, {width, height}};
-    
+    inpuAssemblyState.topology = desc->topology;
+
+    // viewport and scissor are dynamic states
     VkPipelineViewportStateCreateInfo viewportState = {0};
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportState.viewportCount = 1;
-    //viewportState.pViewports = &viewport;
     viewportState.scissorCount = 1;
-    //viewportState.pScissors = &scissor;
 
     VkPipelineRasterizationStateCreateInfo rasterizationState = {0};
     rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizationState.polygonMode = desc->polygonMode;
+    rasterizationState.cullMode = desc->cullMode;
+    rasterizationState.frontFace = desc->frontFace;
     rasterizationState.lineWidth = 1.0f;
 
     VkPipelineMultisampleStateCreateInfo multisampleState = {0};
     multisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_4_BIT;
+    multisampleState.rasterizationSamples = desc->formats.sampleCount;
 
     VkPipelineDepthStencilStateCreateInfo depthStancilState = {0};
     depthStancilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depthStancilState.depthTestEnable = VK_TRUE;
-    depthStancilState.depthWriteEnable = VK_TRUE;
-    depthStancilState.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
-    depthStancilState.maxDepthBounds = 0.0f;
+    depthStancilState.depthTestEnable = desc->depthTest;
+    depthStancilState.depthWriteEnable = desc->depthTest && desc->depthWrite;
+    depthStancilState.depthCompareOp = desc->depthCompareOp;
+    depthStancilState.minDepthBounds = 0.0f;
     depthStancilState.maxDepthBounds = 1.0f;
 
     VkPipelineColorBlendAttachmentState colorBlendAttachment = {0};
     colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
                                     VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_TRUE;
-    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    if (desc->blend == VULKAN_BLEND_ALPHA) {
+        colorBlendAttachment.blendEnable = VK_TRUE;
+        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
 
     VkPipelineColorBlendStateCreateInfo colorBlendState = {0};
     colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -133,20 +160,13 @@ VulkanPipeline createPipeline(VulkanContext *context, const char *vertPath, cons
     dynamicState.dynamicStateCount = ARRAY_COUNT(dynamicStates);
     dynamicState.pDynamicStates = dynamicStates;
 
-    VkPipelineLayout pipelineLayout;
-
-    {
-        VkPipelineLayoutCreateInfo createInfo = {0};
-        createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        createInfo.setLayoutCount = numSetLayouts;
-        createInfo.pSetLayouts = setLayouts;
-        createInfo.pushConstantRangeCount = pushConstant ? 1 : 0;
-        createInfo.pPushConstantRanges = pushConstant;
-
-        if (vkCreatePipelineLayout(context->device, &createInfo, NULL, &pipelineLayout) != VK_SUCCESS) {
-            fprintf(stderr, "Failed to create pipelineLayout!\n");
-            exit(-1);
-        }
+    // without a render pass the pipeline is created against the attachment formats (dynamic rendering)
+    VkPipelineRenderingCreateInfoKHR renderingInfo = {0};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    if (!desc->renderPass) {
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachmentFormats = &desc->formats.colorFormat;
+        renderingInfo.depthAttachmentFormat = desc->formats.depthFormat;
     }
 
     VkPipeline pipeline;
@@ -154,6 +174,7 @@ VulkanPipeline createPipeline(VulkanContext *context, const char *vertPath, cons
     {
         VkGraphicsPipelineCreateInfo createInfo = {0};
         createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        createInfo.pNext = desc->renderPass ? NULL : &renderingInfo;
         createInfo.stageCount = ARRAY_COUNT(shaderStages);
         createInfo.pStages = shaderStages;
         createInfo.pVertexInputState = &vertexInputState;
@@ -165,10 +186,10 @@ VulkanPipeline createPipeline(VulkanContext *context, const char *vertPath, cons
         createInfo.pColorBlendState = &colorBlendState;
         createInfo.pDynamicState = &dynamicState;
         createInfo.layout = pipelineLayout;
-        createInfo.renderPass = renderPass;
+        createInfo.renderPass = desc->renderPass;
         createInfo.subpass = 0;
 
-        if (vkCreateGraphicsPipelines(context->device, 0, 1, &createInfo, 0, &pipeline) != VK_SUCCESS) {
+        if (vkCreateGraphicsPipelines(context->device, context->pipelineCache, 1, &createInfo, 0, &pipeline) != VK_SUCCESS) {
             fprintf(stderr, "Failed to create Graphics pipeline!\n");
             exit(-1);
         }
@@ -181,9 +202,11 @@ VulkanPipeline createPipeline(VulkanContext *context, const char *vertPath, cons
     VulkanPipeline result = {0};
     result.pipeline = pipeline;
     result.layout = pipelineLayout;
+    if (desc->drawData) {
+        result.drawData = *desc->drawData;
+    }
 
     return result;
-
 }
 
 void destroyPipeline(VulkanContext *context, VulkanPipeline *pipeline) {
@@ -191,3 +214,275 @@ void destroyPipeline(VulkanContext *context, VulkanPipeline *pipeline) {
     vkDestroyPipelineLayout(context->device, pipeline->layout, NULL);
 }
 
+// Flat byte copy of a pipeline description, equal keys create equal pipelines
+typedef struct {
+    uint8_t* data;
+    uint32_t size;
+    uint32_t capacity;
+} PipelineKey;
+
+static void keyWrite(PipelineKey* key, const void* data, size_t size) {
+    if (key->size + size > key->capacity) {
+        uint32_t capacity = key->capacity ? key->capacity : 256;
+        while (capacity < key->size + size) capacity *= 2;
+        uint8_t* newData = realloc(key->data, capacity);
+        if (!newData) {
+            fprintf(stderr, "Failed to grow pipeline key!\n");
+            exit(-1);
+        }
+        key->data = newData;
+        key->capacity = capacity;
+    }
+    if (size) memcpy(key->data + key->size, data, size);
+    key->size += size;
+}
+
+static void keyWriteU32(PipelineKey* key, uint32_t value) {
+    keyWrite(key, &value, sizeof(value));
+}
+
+static void keyWriteString(PipelineKey* key, const char* string) {
+    uint32_t length = string ? (uint32_t)strlen(string) : 0;
+    keyWriteU32(key, length);
+    keyWrite(key, string, length);
+}
+
+static void writeLayoutKey(PipelineKey* key, const VulkanPipelineDesc* desc, const VkPushConstantRange* pushConstant) {
+    keyWriteU32(key, desc->setLayoutCount);
+    keyWrite(key, desc->setLayouts, sizeof(VkDescriptorSetLayout) * desc->setLayoutCount);
+    keyWriteU32(key, pushConstant ? 1 : 0);
+    if (pushConstant) keyWrite(key, pushConstant, sizeof(VkPushConstantRange));
+}
+
+// fields are written one by one, struct padding would make equal descriptions differ
+static void writePipelineKey(PipelineKey* key, const VulkanPipelineDesc* desc) {
+    keyWriteString(key, desc->vertPath);
+    keyWriteString(key, desc->fragPath);
+
+    const VkSpecializationInfo* specialization = desc->fragSpecialization;
+    keyWriteU32(key, specialization ? specialization->mapEntryCount : 0);
+    if (specialization) {
+        for (uint32_t i = 0; i < specialization->mapEntryCount; i++) {
+            const VkSpecializationMapEntry* entry = &specialization->pMapEntries[i];
+            keyWriteU32(key, entry->constantID);
+            keyWriteU32(key, entry->offset);
+            keyWriteU32(key, (uint32_t)entry->size);
+        }
+        keyWriteU32(key, (uint32_t)specialization->dataSize);
+        keyWrite(key, specialization->pData, specialization->dataSize);
+    }
+
+    keyWriteU32(key, desc->attributeCount);
+    keyWrite(key, desc->attributes, sizeof(VkVertexInputAttributeDescription) * desc->attributeCount);
+    keyWriteU32(key, desc->binding ? 1 : 0);
+    if (desc->binding) {
+        keyWriteU32(key, desc->binding->binding);
+        keyWriteU32(key, desc->binding->stride);
+        keyWriteU32(key, desc->binding->inputRate);
+    }
+
+    keyWriteU32(key, desc->drawData ? 1 : 0);
+    if (desc->drawData) {
+        keyWriteU32(key, desc->drawData->size);
+        keyWriteU32(key, desc->drawData->stages);
+        keyWriteU32(key, desc->drawData->set);
+        keyWriteU32(key, desc->drawData->pushConstants);
+    }
+
+    keyWriteU32(key, desc->topology);
+    keyWriteU32(key, desc->polygonMode);
+    keyWriteU32(key, desc->cullMode);
+    keyWriteU32(key, desc->frontFace);
+    keyWriteU32(key, desc->depthTest);
+    keyWriteU32(key, desc->depthWrite);
+    keyWriteU32(key, desc->depthCompareOp);
+    keyWriteU32(key, desc->blend);
+
+    keyWrite(key, &desc->renderPass, sizeof(desc->renderPass));
+    keyWriteU32(key, desc->formats.colorFormat);
+    keyWriteU32(key, desc->formats.depthFormat);
+    keyWriteU32(key, desc->formats.sampleCount);
+}
+
+static VulkanPipelineEntry* findEntry(VulkanPipelineEntry* entries, uint32_t count, uint64_t hash, const uint8_t* key, uint32_t keySize) {
+    for (uint32_t i = 0; i < count; i++) {
+        VulkanPipelineEntry* entry = &entries[i];
+        if (entry->hash == hash && entry->keySize == keySize && memcmp(entry->key, key, keySize) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static VulkanPipelineEntry* addEntry(VulkanPipelineEntry** entries, uint32_t* count, uint32_t* capacity,
+        uint64_t hash, const uint8_t* key, uint32_t keySize) {
+    if (*count == *capacity) {
+        uint32_t newCapacity = *capacity ? *capacity * 2 : 16;
+        VulkanPipelineEntry* newEntries = realloc(*entries, sizeof(VulkanPipelineEntry) * newCapacity);
+        if (!newEntries) {
+            fprintf(stderr, "Failed to grow pipeline registry!\n");
+            exit(-1);
+        }
+        *entries = newEntries;
+        *capacity = newCapacity;
+    }
+
+    uint8_t* keyCopy = malloc(keySize);
+    if (!keyCopy) {
+        fprintf(stderr, "Failed to allocate pipeline key!\n");
+        exit(-1);
+    }
+    memcpy(keyCopy, key, keySize);
+
+    VulkanPipelineEntry* entry = &(*entries)[(*count)++];
+    *entry = (VulkanPipelineEntry){0};
+    entry->hash = hash;
+    entry->key = keyCopy;
+    entry->keySize = keySize;
+    return entry;
+}
+
+static void removeEntry(VulkanPipelineEntry* entries, uint32_t* count, VulkanPipelineEntry* entry) {
+    free(entry->key);
+    *entry = entries[--(*count)];
+}
+
+// Returns the pipeline for desc, created on first use. Every acquire needs a releasePipeline.
+VulkanPipeline acquirePipeline(VulkanContext* context, const VulkanPipelineDesc* desc) {
+    VulkanPipelineRegistry* registry = &context->pipelineRegistry;
+
+    VkPushConstantRange drawDataRange;
+    const VkPushConstantRange* pushConstant = getPushConstantRange(desc, &drawDataRange);
+
+    // the layout key is the start of the pipeline key
+    PipelineKey key = {0};
+    writeLayoutKey(&key, desc, pushConstant);
+    uint32_t layoutKeySize = key.size;
+    writePipelineKey(&key, desc);
+
+    uint64_t hash = hashBytes(VULKAN_HASH_SEED, key.data, key.size);
+    VulkanPipelineEntry* entry = findEntry(registry->pipelines, registry->pipelineCount, hash, key.data, key.size);
+    if (entry) {
+        entry->references++;
+        registry->reusedPipelines++;
+        free(key.data);
+        return entry->pipeline;
+    }
+
+    uint64_t layoutHash = hashBytes(VULKAN_HASH_SEED, key.data, layoutKeySize);
+    VulkanPipelineEntry* layoutEntry = findEntry(registry->layouts, registry->layoutCount, layoutHash, key.data, layoutKeySize);
+    if (!layoutEntry) {
+        VkPipelineLayoutCreateInfo createInfo = {0};
+        createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        createInfo.setLayoutCount = desc->setLayoutCount;
+        createInfo.pSetLayouts = desc->setLayouts;
+        createInfo.pushConstantRangeCount = pushConstant ? 1 : 0;
+        createInfo.pPushConstantRanges = pushConstant;
+
+        VkPipelineLayout layout;
+        if (vkCreatePipelineLayout(context->device, &createInfo, NULL, &layout) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create pipelineLayout!\n");
+            exit(-1);
+        }
+
+        layoutEntry = addEntry(&registry->layouts, &registry->layoutCount, &registry->layoutCapacity,
+                               layoutHash, key.data, layoutKeySize);
+        layoutEntry->pipeline.layout = layout;
+    }
+    layoutEntry->references++;
+
+    VulkanPipeline pipeline = createPipeline(context, desc, layoutEntry->pipeline.layout);
+
+    entry = addEntry(&registry->pipelines, &registry->pipelineCount, &registry->pipelineCapacity, hash, key.data, key.size);
+    entry->references = 1;
+    entry->pipeline = pipeline;
+    registry->createdPipelines++;
+
+    free(key.data);
+    return pipeline;
+}
+
+// The pipeline, and its layout if no other pipeline uses it, is destroyed once the graphics
+// timeline reaches retireValue after the last release.
+void releasePipeline(VulkanContext* context, VulkanPipeline* pipeline, uint64_t retireValue) {
+    VulkanPipelineRegistry* registry = &context->pipelineRegistry;
+    if (!pipeline->pipeline) return;
+
+    VulkanPipelineEntry* entry = NULL;
+    for (uint32_t i = 0; i < registry->pipelineCount; i++) {
+        if (registry->pipelines[i].pipeline.pipeline == pipeline->pipeline) entry = &registry->pipelines[i];
+    }
+    *pipeline = (VulkanPipeline){0};
+    if (!entry) {
+        fprintf(stderr, "Released a pipeline that is not in the registry!\n");
+        return;
+    }
+    if (--entry->references) return;
+
+    VkPipelineLayout layout = entry->pipeline.layout;
+    VulkanPipeline retired = { .pipeline = entry->pipeline.pipeline }; // the layout is shared
+    deferDestroyPipeline(context, &retired, retireValue);
+    removeEntry(registry->pipelines, &registry->pipelineCount, entry);
+
+    for (uint32_t i = 0; i < registry->layoutCount; i++) {
+        VulkanPipelineEntry* layoutEntry = &registry->layouts[i];
+        if (layoutEntry->pipeline.layout != layout) continue;
+
+        if (--layoutEntry->references == 0) {
+            deferDestroyPipelineLayout(context, layout, retireValue);
+            removeEntry(registry->layouts, &registry->layoutCount, layoutEntry);
+        }
+        break;
+    }
+}
+
+// the device has to be idle
+void destroyPipelineRegistry(VulkanContext* context) {
+    VulkanPipelineRegistry* registry = &context->pipelineRegistry;
+
+    for (uint32_t i = 0; i < registry->pipelineCount; i++) {
+        vkDestroyPipeline(context->device, registry->pipelines[i].pipeline.pipeline, NULL);
+        free(registry->pipelines[i].key);
+    }
+    for (uint32_t i = 0; i < registry->layoutCount; i++) {
+        vkDestroyPipelineLayout(context->device, registry->layouts[i].pipeline.layout, NULL);
+        free(registry->layouts[i].key);
+    }
+    free(registry->pipelines);
+    free(registry->layouts);
+    *registry = (VulkanPipelineRegistry){0};
+}
+
+
+// allowPushConstants false always uses the uniform buffer path, e.g. to compare both
+VulkanDrawDataLayout selectDrawDataLayout(VulkanContext* context, uint32_t size, VkShaderStageFlags stages, uint32_t set, bool allowPushConstants) {
+    VulkanDrawDataLayout result = {0};
+    result.size = size;
+    result.stages = stages;
+    result.set = set;
+    result.pushConstants = allowPushConstants && size <= context->physicalDeviceProperties.limits.maxPushConstantsSize;
+    return result;
+}
+
+// Hands this draw's data to the bound pipeline. Without push constants the data is copied into
+// the frame allocator and set, which has to hold the dynamic uniform buffer as its only dynamic
+// descriptor, is bound at the new offset. Returns false if the frame allocator is full.
+bool cmdSetDrawData(VkCommandBuffer commandBuffer, const VulkanPipeline* pipeline, VulkanFrameAllocator* allocator,
+        VkDescriptorSet set, const void* data) {
+    const VulkanDrawDataLayout* drawData = &pipeline->drawData;
+
+    if (drawData->pushConstants) {
+        vkCmdPushConstants(commandBuffer, pipeline->layout, drawData->stages, 0, drawData->size, data);
+        return true;
+    }
+
+    uint32_t offset;
+    void* mapped = frameAllocate(allocator, drawData->size, &offset);
+    if (!mapped) {
+        return false;
+    }
+    memcpy(mapped, data, drawData->size);
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout, drawData->set, 1, &set, 1, &offset);
+    return true;
+}
@@ -0,0 +1,200 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vulkan/vulkan_core.h>
+
+#include "../include/vulkan_base.h"
+
+bool createReadbackRing(VulkanContext* context, VulkanReadbackRing* ring, uint32_t slotCount) {
+    *ring = (VulkanReadbackRing){0};
+    ring->slots = calloc(slotCount, sizeof(VulkanReadbackSlot));
+    if (!ring->slots) {
+        fprintf(stderr, "Failed to allocate readback slots!\n");
+        return false;
+    }
+    ring->slotCount = slotCount;
+    return true;
+}
+
+static void destroySlotBuffer(VulkanContext* context, VulkanReadbackSlot* slot) {
+    if (!slot->buffer.buffer) return;
+
+    vkUnmapMemory(context->device, slot->buffer.memory);
+    destroyBuffer(context, &slot->buffer);
+    slot->buffer = (VulkanBuffer){0};
+    slot->mapped = NULL;
+    slot->size = 0;
+}
+
+void destroyReadbackRing(VulkanContext* context, VulkanReadbackRing* ring) {
+    for (uint32_t i = 0; i < ring->slotCount; i++) {
+        destroySlotBuffer(context, &ring->slots[i]);
+    }
+    free(ring->slots);
+    *ring = (VulkanReadbackRing){0};
+}
+
+// Free slots are not in use by the gpu, so their buffer can be replaced right away
+static bool reserveSlotBuffer(VulkanContext* context, VulkanReadbackSlot* slot, VkDeviceSize size) {
+    if (slot->size >= size) return true;
+
+    destroySlotBuffer(context, slot);
+    createBuffer(context, &slot->buffer, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VULKAN_MEMORY_STAGING);
+    if (!slot->buffer.memory) {
+        return false;
+    }
+
+    if (vkMapMemory(context->device, slot->buffer.memory, 0, size, 0, &slot->mapped) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to map readback buffer!\n");
+        destroyBuffer(context, &slot->buffer);
+        slot->buffer = (VulkanBuffer){0};
+        return false;
+    }
+
+    slot->size = size;
+    return true;
+}
+
+static uint32_t getFormatSize(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+// Records a copy of a color image (in layout, and left in it) into the next free slot.
+// Returns NULL if every slot is still waiting for the gpu or being read by the caller.
+// The caller sets readyValue of the returned slot to the submit value of commandBuffer.
+VulkanReadbackSlot* cmdReadbackImage(VulkanContext* context, VulkanReadbackRing* ring, VkCommandBuffer commandBuffer,
+        VkImage image, VkImageLayout layout, VkFormat format, uint32_t width, uint32_t height, uint64_t tag) {
+    if (ring->busyCount == ring->slotCount) {
+        return NULL;
+    }
+
+    uint32_t pixelSize = getFormatSize(format);
+    if (pixelSize == 0) {
+        fprintf(stderr, "Readback of image format %d is not supported!\n", format);
+        return NULL;
+    }
+
+    // polled slots left the ring but stay busy until the caller released them
+    VulkanReadbackSlot* slot = &ring->slots[(ring->oldest + ring->busyCount) % ring->slotCount];
+    if (slot->busy) {
+        return NULL;
+    }
+
+    if (!reserveSlotBuffer(context, slot, (VkDeviceSize)width * height * pixelSize)) {
+        return NULL;
+    }
+
+    slot->width = width;
+    slot->height = height;
+    slot->format = format;
+    slot->tag = tag;
+    slot->readyValue = 0;
+    slot->busy = true;
+    ring->busyCount++;
+
+    cmdTransitionImage(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT,
+                       layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+    VkBufferImageCopy region = {0};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = (VkExtent3D){ width, height, 1 };
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer.buffer, 1, &region);
+
+    cmdTransitionImage(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT,
+                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+
+    // make the copy visible to the host once the timeline signals
+    VkBufferMemoryBarrier bufferBarrier = {0};
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = slot->buffer.buffer;
+    bufferBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 0, NULL, 1, &bufferBarrier, 0, NULL);
+
+    return slot;
+}
+
+// Returns the oldest finished slot without blocking, NULL if the gpu is not done with it yet.
+// The slot stays reserved until releaseReadback.
+VulkanReadbackSlot* pollReadback(VulkanContext* context, VulkanReadbackRing* ring) {
+    if (ring->busyCount == 0) return NULL;
+
+    VulkanReadbackSlot* slot = &ring->slots[ring->oldest];
+    if (slot->readyValue == 0) return NULL; // not submitted yet
+    if (getCompletedTimelineValue(context, &context->graphicsQueue) < slot->readyValue) return NULL;
+
+    ring->oldest = (ring->oldest + 1) % ring->slotCount;
+    ring->busyCount--;
+    return slot;
+}
+
+// Slots are handed out in order, so a released slot is only reused after all older ones
+void releaseReadback(VulkanReadbackSlot* slot) {
+    slot->busy = false;
+    slot->readyValue = 0;
+}
+
+static uint8_t unpack10(uint32_t value, uint32_t shift) {
+    return (uint8_t)(((value >> shift) & 0x3FF) * 255 / 1023);
+}
+
+// Converts the slot's pixels to tightly packed 8 bit RGBA. sRGB encoded formats stay encoded,
+// so the result matches what was presented.
+bool readbackToRgba8(const VulkanReadbackSlot* slot, uint8_t* pixels) {
+    uint32_t count = slot->width * slot->height;
+    const uint8_t* source = slot->mapped;
+
+    switch (slot->format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            memcpy(pixels, source, (size_t)count * 4);
+            return true;
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            for (uint32_t i = 0; i < count; i++) {
+                pixels[i * 4 + 0] = source[i * 4 + 2];
+                pixels[i * 4 + 1] = source[i * 4 + 1];
+                pixels[i * 4 + 2] = source[i * 4 + 0];
+                pixels[i * 4 + 3] = source[i * 4 + 3];
+            }
+            return true;
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        case VK_FORMAT_A2R10G10B10_UNORM_PACK32: {
+            bool bgr = slot->format == VK_FORMAT_A2R10G10B10_UNORM_PACK32;
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t value;
+                memcpy(&value, source + i * 4, sizeof(value));
+                pixels[i * 4 + 0] = unpack10(value, bgr ? 20 : 0);
+                pixels[i * 4 + 1] = unpack10(value, 10);
+                pixels[i * 4 + 2] = unpack10(value, bgr ? 0 : 20);
+                pixels[i * 4 + 3] = (uint8_t)((value >> 30) * 85);
+            }
+            return true;
+        }
+        default:
+            fprintf(stderr, "Cant convert readback format %d to rgba8!\n", slot->format);
+            return false;
+    }
+}
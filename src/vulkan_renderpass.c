@@ -4,56 +4,148 @@
 
 #include "../include/vulkan_base.h"
 
-VkRenderPass createRenderPass(VulkanContext *context, VkFormat format, VkSampleCountFlags sampleCount) {
-    VkRenderPass renderPass;
+// Depth formats in order of preference. With the reversed z projection a float
+// format keeps the precision, the unorm ones trade it for bandwidth.
+static const VkFormat depthFormatCandidates[] = {
+    VK_FORMAT_D32_SFLOAT,
+    VK_FORMAT_X8_D24_UNORM_PACK32,
+    VK_FORMAT_D24_UNORM_S8_UINT,
+    VK_FORMAT_D16_UNORM,
+};
+
+static bool isDepthFormatSupported(VulkanContext* context, VkFormat format) {
+    VkFormatProperties properties = {0};
+    vkGetPhysicalDeviceFormatProperties(context->physicalDevice, format, &properties);
+    return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) != 0;
+}
+
+VkFormat selectDepthFormat(VulkanContext* context, VkFormat preferred) {
+    if (preferred != VK_FORMAT_UNDEFINED && isDepthFormatSupported(context, preferred)) {
+        return preferred;
+    }
+
+    for (uint32_t i = 0; i < ARRAY_COUNT(depthFormatCandidates); i++) {
+        if (isDepthFormatSupported(context, depthFormatCandidates[i])) {
+            if (preferred != VK_FORMAT_UNDEFINED) {
+                fprintf(stderr, "Depth format %d not supported, using %d!\n", preferred, depthFormatCandidates[i]);
+            }
+            return depthFormatCandidates[i];
+        }
+    }
+
+    fprintf(stderr, "Failed to find a supported depth format!\n");
+    return VK_FORMAT_UNDEFINED;
+}
+
+bool isSampleCountSupported(VulkanContext* context, VkSampleCountFlagBits sampleCount) {
+    VkPhysicalDeviceLimits* limits = &context->physicalDeviceProperties.limits;
+    VkSampleCountFlags supported = limits->framebufferColorSampleCounts & limits->framebufferDepthSampleCounts;
+    return (supported & sampleCount) != 0;
+}
+
+// Highest sample count up to the requested one that color and depth attachments both support
+VkSampleCountFlagBits selectSampleCount(VulkanContext* context, VkSampleCountFlagBits requested) {
+    VkSampleCountFlagBits result = requested;
+    while (result > VK_SAMPLE_COUNT_1_BIT && !isSampleCountSupported(context, result)) {
+        result = (VkSampleCountFlagBits)(result >> 1);
+    }
+
+    if (result != requested) {
+        fprintf(stderr, "%ux MSAA not supported, using %ux!\n", requested, result);
+    }
+    return result;
+}
+
+// Single subpass render pass. With more than one sample the color attachment is resolved
+// into a single sampled one, depthFormat VK_FORMAT_UNDEFINED leaves out the depth buffer.
+// Framebuffer attachment order: color, depth (optional), resolve (multisampled only)
+VkRenderPass createRenderPass(VulkanContext *context, VkFormat format, VkFormat depthFormat,
+        VkSampleCountFlagBits sampleCount, VkImageLayout finalLayout) {
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    bool hasDepth = depthFormat != VK_FORMAT_UNDEFINED;
+    bool resolve = sampleCount != VK_SAMPLE_COUNT_1_BIT;
     
     VkAttachmentDescription attachmentDescriptions[3] = {0};
-    attachmentDescriptions[0].format = format;
-    attachmentDescriptions[0].samples = sampleCount;
-    attachmentDescriptions[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attachmentDescriptions[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attachmentDescriptions[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachmentDescriptions[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    attachmentDescriptions[1].format = VK_FORMAT_D32_SFLOAT;
-    attachmentDescriptions[1].samples = sampleCount;
-    attachmentDescriptions[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attachmentDescriptions[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attachmentDescriptions[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachmentDescriptions[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    attachmentDescriptions[2].format = format;
-    attachmentDescriptions[2].samples = VK_SAMPLE_COUNT_1_BIT;
-    attachmentDescriptions[2].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    attachmentDescriptions[2].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attachmentDescriptions[2].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachmentDescriptions[2].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    uint32_t attachmentCount = 0;
 
     VkAttachmentReference attachmentReference = {0};
-    attachmentReference.attachment = 0;
+    attachmentReference.attachment = attachmentCount++;
     attachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    VkAttachmentDescription* color = &attachmentDescriptions[attachmentReference.attachment];
+    color->format = format;
+    color->samples = sampleCount;
+    color->loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color->storeOp = resolve ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE; // only the resolve is needed
+    color->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    color->finalLayout = resolve ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : finalLayout;
+
     VkAttachmentReference depthStencilReference = {0};
-    depthStencilReference.attachment = 1;
-    depthStencilReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    if (hasDepth) {
+        depthStencilReference.attachment = attachmentCount++;
+        depthStencilReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentDescription* depth = &attachmentDescriptions[depthStencilReference.attachment];
+        depth->format = depthFormat;
+        depth->samples = sampleCount;
+        depth->loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depth->storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depth->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depth->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depth->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depth->finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    }
 
     VkAttachmentReference resolveTargetReference = {0};
-    resolveTargetReference.attachment = 2;
-    resolveTargetReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    if (resolve) {
+        resolveTargetReference.attachment = attachmentCount++;
+        resolveTargetReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentDescription* resolveTarget = &attachmentDescriptions[resolveTargetReference.attachment];
+        resolveTarget->format = format;
+        resolveTarget->samples = VK_SAMPLE_COUNT_1_BIT;
+        resolveTarget->loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        resolveTarget->storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        resolveTarget->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        resolveTarget->finalLayout = finalLayout;
+    }
 
     VkSubpassDescription subpass = {0};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &attachmentReference;
-    subpass.pDepthStencilAttachment = &depthStencilReference;
-    subpass.pResolveAttachments = &resolveTargetReference;
+    subpass.pDepthStencilAttachment = hasDepth ? &depthStencilReference : NULL;
+    subpass.pResolveAttachments = resolve ? &resolveTargetReference : NULL;
+
+    VkSubpassDependency dependencies[2] = {0};
+
+    // the layout transitions wait for the acquire semaphore (waited on at COLOR_ATTACHMENT_OUTPUT)
+    // and the previous frame that used the same attachments
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    // a result that is sampled afterwards (post processing) has to be visible to the fragment shader
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
     VkRenderPassCreateInfo createInfo = {0};
     createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    createInfo.attachmentCount = ARRAY_COUNT(attachmentDescriptions);
+    createInfo.attachmentCount = attachmentCount;
     createInfo.pAttachments = attachmentDescriptions;
     createInfo.subpassCount = 1;
     createInfo.pSubpasses = &subpass;
+    createInfo.dependencyCount = finalLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL ? 2 : 1;
+    createInfo.pDependencies = dependencies;
 
     if (vkCreateRenderPass(context->device, &createInfo, NULL, &renderPass) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create vulkan renderpass!\n");
@@ -63,6 +155,26 @@ VkRenderPass createRenderPass(VulkanContext *context, VkFormat format, VkSampleC
     return renderPass;
 }
 
+VkFramebuffer createFramebuffer(VulkanContext* context, VkRenderPass renderPass, uint32_t attachmentCount,
+        VkImageView* attachments, uint32_t width, uint32_t height) {
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+    VkFramebufferCreateInfo createInfo = {0};
+    createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    createInfo.renderPass = renderPass;
+    createInfo.attachmentCount = attachmentCount;
+    createInfo.pAttachments = attachments;
+    createInfo.width = width;
+    createInfo.height = height;
+    createInfo.layers = 1;
+
+    if (vkCreateFramebuffer(context->device, &createInfo, NULL, &framebuffer) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create vulkan framebuffers!\n");
+    }
+
+    return framebuffer;
+}
+
 void destroyRenderPass(VulkanContext *context, VkRenderPass renderPass) {
     vkDestroyRenderPass(context->device, renderPass, NULL);
 }
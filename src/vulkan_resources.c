@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan_core.h>
+
+#include "../include/vulkan_base.h"
+
+static uint32_t makeHandle(uint32_t index, uint32_t generation) {
+    return (generation << VULKAN_HANDLE_INDEX_BITS) | index;
+}
+
+// Grows the slot arrays and the pool's resource array (*items) together
+static bool growPool(VulkanHandlePool* pool, void** items, size_t itemSize) {
+    uint32_t capacity = pool->capacity ? pool->capacity * 2 : 64;
+    if (capacity > VULKAN_HANDLE_MAX_SLOTS) capacity = VULKAN_HANDLE_MAX_SLOTS;
+    if (capacity == pool->capacity) {
+        fprintf(stderr, "Resource pool is full!\n");
+        return false;
+    }
+
+    uint16_t* generations = realloc(pool->generations, sizeof(uint16_t) * capacity);
+    if (generations) pool->generations = generations;
+    uint32_t* freeSlots = realloc(pool->freeSlots, sizeof(uint32_t) * capacity);
+    if (freeSlots) pool->freeSlots = freeSlots;
+    void* newItems = realloc(*items, itemSize * capacity);
+    if (newItems) *items = newItems;
+
+    if (!generations || !freeSlots || !newItems) {
+        fprintf(stderr, "Failed to grow resource pool!\n");
+        return false;
+    }
+    pool->capacity = capacity;
+    return true;
+}
+
+// Returns the index of a free slot, or UINT32_MAX
+static uint32_t allocateSlot(VulkanHandlePool* pool, void** items, size_t itemSize) {
+    uint32_t index;
+    if (pool->freeCount) {
+        index = pool->freeSlots[--pool->freeCount];
+    }
+    else {
+        if (pool->slotCount == pool->capacity && !growPool(pool, items, itemSize)) {
+            return UINT32_MAX;
+        }
+        index = pool->slotCount++;
+        pool->generations[index] = 1;
+    }
+    pool->liveCount++;
+    return index;
+}
+
+static bool resolveHandle(const VulkanHandlePool* pool, uint32_t handle, uint32_t* index) {
+    *index = handle & (VULKAN_HANDLE_MAX_SLOTS - 1);
+    uint32_t generation = handle >> VULKAN_HANDLE_INDEX_BITS;
+    return handle != 0 && *index < pool->slotCount && pool->generations[*index] == generation;
+}
+
+// The new generation invalidates every handle to the slot, 0 is skipped so no handle is ever 0
+static void freeSlot(VulkanHandlePool* pool, uint32_t index) {
+    uint16_t generation = (pool->generations[index] + 1) & VULKAN_HANDLE_GENERATION_MASK;
+    pool->generations[index] = generation ? generation : 1;
+    pool->freeSlots[pool->freeCount++] = index;
+    pool->liveCount--;
+}
+
+VulkanBufferHandle createPooledBuffer(VulkanContext* context, uint64_t size, VkBufferUsageFlags usage,
+        VkMemoryPropertyFlags memoryProperties, VulkanMemoryCategory category) {
+    VulkanBufferPool* pool = &context->bufferPool;
+
+    uint32_t index = allocateSlot(&pool->handles, (void**)&pool->buffers, sizeof(VulkanBuffer));
+    if (index == UINT32_MAX) {
+        return (VulkanBufferHandle){0};
+    }
+
+    createBuffer(context, &pool->buffers[index], size, usage, memoryProperties, category);
+    return (VulkanBufferHandle){ makeHandle(index, pool->handles.generations[index]) };
+}
+
+// NULL for a released or never created handle
+VulkanBuffer* getBuffer(VulkanContext* context, VulkanBufferHandle handle) {
+    VulkanBufferPool* pool = &context->bufferPool;
+
+    uint32_t index;
+    if (!resolveHandle(&pool->handles, handle.value, &index)) {
+        fprintf(stderr, "Stale buffer handle 0x%08x!\n", handle.value);
+        return NULL;
+    }
+    return &pool->buffers[index];
+}
+
+// A frame that uses the resource may still be recording and gets the next timeline value,
+// so a release never retires before that, even if lastUse says the gpu is done with it.
+static uint64_t getReleaseValue(VulkanContext* context, uint64_t lastUse) {
+    uint64_t nextSubmit = context->graphicsQueue.timelineValue + 1;
+    return lastUse > nextSubmit ? lastUse : nextSubmit;
+}
+
+// The handle is invalid right away, the buffer is destroyed once the gpu passed its release value.
+void releaseBuffer(VulkanContext* context, VulkanBufferHandle* handle) {
+    VulkanBufferPool* pool = &context->bufferPool;
+    if (!handle->value) return;
+
+    uint32_t index;
+    if (!resolveHandle(&pool->handles, handle->value, &index)) {
+        fprintf(stderr, "Released stale buffer handle 0x%08x!\n", handle->value);
+        return;
+    }
+
+    VulkanBuffer* buffer = &pool->buffers[index];
+    buffer->lastUse = getReleaseValue(context, buffer->lastUse);
+    deferDestroyBuffer(context, buffer);
+    freeSlot(&pool->handles, index);
+    *handle = (VulkanBufferHandle){0};
+}
+
+VulkanImageHandle createPooledImage(VulkanContext* context, uint32_t width, uint32_t height, VkFormat format,
+        VkImageUsageFlags usage, VkSampleCountFlagBits sampleCount, VulkanMemoryCategory category) {
+    VulkanImagePool* pool = &context->imagePool;
+
+    uint32_t index = allocateSlot(&pool->handles, (void**)&pool->images, sizeof(VulkanImage));
+    if (index == UINT32_MAX) {
+        return (VulkanImageHandle){0};
+    }
+
+    createImage(context, &pool->images[index], width, height, format, usage, sampleCount, category);
+    return (VulkanImageHandle){ makeHandle(index, pool->handles.generations[index]) };
+}
+
+VulkanImage* getImage(VulkanContext* context, VulkanImageHandle handle) {
+    VulkanImagePool* pool = &context->imagePool;
+
+    uint32_t index;
+    if (!resolveHandle(&pool->handles, handle.value, &index)) {
+        fprintf(stderr, "Stale image handle 0x%08x!\n", handle.value);
+        return NULL;
+    }
+    return &pool->images[index];
+}
+
+void releaseImage(VulkanContext* context, VulkanImageHandle* handle) {
+    VulkanImagePool* pool = &context->imagePool;
+    if (!handle->value) return;
+
+    uint32_t index;
+    if (!resolveHandle(&pool->handles, handle->value, &index)) {
+        fprintf(stderr, "Released stale image handle 0x%08x!\n", handle->value);
+        return;
+    }
+
+    VulkanImage* image = &pool->images[index];
+    image->lastUse = getReleaseValue(context, image->lastUse);
+    deferDestroyImage(context, image);
+    freeSlot(&pool->handles, index);
+    *handle = (VulkanImageHandle){0};
+}
+
+static void freeHandlePool(VulkanHandlePool* pool) {
+    free(pool->generations);
+    free(pool->freeSlots);
+    *pool = (VulkanHandlePool){0};
+}
+
+// The device has to be idle. Resources still alive were never released, they are destroyed
+// here but reported since the owner probably leaks something else as well.
+void destroyResourcePools(VulkanContext* context) {
+    VulkanBufferPool* bufferPool = &context->bufferPool;
+    VulkanImagePool* imagePool = &context->imagePool;
+
+    if (bufferPool->handles.liveCount || imagePool->handles.liveCount) {
+        fprintf(stderr, "%u buffers and %u images were never released!\n",
+                bufferPool->handles.liveCount, imagePool->handles.liveCount);
+    }
+
+    for (uint32_t i = 0; i < bufferPool->handles.slotCount; i++) {
+        if (bufferPool->buffers[i].buffer) destroyBuffer(context, &bufferPool->buffers[i]);
+    }
+    for (uint32_t i = 0; i < imagePool->handles.slotCount; i++) {
+        if (imagePool->images[i].image) destroyImage(context, &imagePool->images[i]);
+    }
+
+    freeHandlePool(&bufferPool->handles);
+    freeHandlePool(&imagePool->handles);
+    free(bufferPool->buffers);
+    free(imagePool->images);
+    *bufferPool = (VulkanBufferPool){0};
+    *imagePool = (VulkanImagePool){0};
+}
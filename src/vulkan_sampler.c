@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vulkan/vulkan_core.h>
+
+#include "../include/vulkan_base.h"
+
+// Returns the sampler for desc, created on first use and owned by the cache. Anisotropy is
+// clamped to what the device supports first, so requests that end up equal share a sampler.
+VkSampler getSampler(VulkanContext* context, const VulkanSamplerDesc* desc) {
+    VulkanSamplerCache* cache = &context->samplerCache;
+
+    VulkanSamplerDesc key = *desc;
+    float maxAnisotropy = context->physicalDeviceProperties.limits.maxSamplerAnisotropy;
+    if (!context->supportsSamplerAnisotropy || key.maxAnisotropy <= 1.0f) key.maxAnisotropy = 1.0f;
+    else if (key.maxAnisotropy > maxAnisotropy) key.maxAnisotropy = maxAnisotropy;
+
+    // every field is 4 bytes, there is no padding to compare
+    for (uint32_t i = 0; i < cache->count; i++) {
+        if (memcmp(&cache->entries[i].desc, &key, sizeof(key)) == 0) {
+            return cache->entries[i].sampler;
+        }
+    }
+
+    if (cache->count == cache->capacity) {
+        uint32_t capacity = cache->capacity ? cache->capacity * 2 : 8;
+        VulkanSamplerEntry* entries = realloc(cache->entries, sizeof(VulkanSamplerEntry) * capacity);
+        if (!entries) {
+            fprintf(stderr, "Failed to grow sampler cache!\n");
+            return VK_NULL_HANDLE;
+        }
+        cache->entries = entries;
+        cache->capacity = capacity;
+    }
+
+    VkSamplerCreateInfo createInfo = {0};
+    createInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    createInfo.magFilter = key.magFilter;
+    createInfo.minFilter = key.minFilter;
+    createInfo.mipmapMode = key.mipmapMode;
+    createInfo.addressModeU = key.addressModeU;
+    createInfo.addressModeV = key.addressModeV;
+    createInfo.addressModeW = key.addressModeW;
+    createInfo.mipLodBias = 0.0f;
+    createInfo.anisotropyEnable = key.maxAnisotropy > 1.0f;
+    createInfo.maxAnisotropy = key.maxAnisotropy;
+    createInfo.minLod = 0.0f;
+    createInfo.maxLod = key.maxLod > 0.0f ? key.maxLod : VK_LOD_CLAMP_NONE;
+
+    VkSampler sampler;
+    if (vkCreateSampler(context->device, &createInfo, NULL, &sampler) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create sampler!\n");
+        return VK_NULL_HANDLE;
+    }
+
+    cache->entries[cache->count++] = (VulkanSamplerEntry){ key, sampler };
+    return sampler;
+}
+
+void destroySamplerCache(VulkanContext* context) {
+    VulkanSamplerCache* cache = &context->samplerCache;
+    for (uint32_t i = 0; i < cache->count; i++) {
+        vkDestroySampler(context->device, cache->entries[i].sampler, NULL);
+    }
+    free(cache->entries);
+    *cache = (VulkanSamplerCache){0};
+}
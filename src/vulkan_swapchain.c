@@ -1,6 +1,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vulkan/vulkan_core.h>
 
 #include "../include/vulkan_base.h"
@@ -8,7 +9,79 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
-VulkanSwapchain createSwapchain(GLFWwindow* window, VulkanContext* context, VkSurfaceKHR surface, VkImageUsageFlags usage, VulkanSwapchain* oldSwapchain) {
+static const struct {
+    const char* name;
+    VkPresentModeKHR mode;
+} presentModeNames[] = {
+    { "fifo", VK_PRESENT_MODE_FIFO_KHR },
+    { "fifo-relaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR },
+    { "mailbox", VK_PRESENT_MODE_MAILBOX_KHR },
+    { "immediate", VK_PRESENT_MODE_IMMEDIATE_KHR },
+};
+
+const char* presentModeName(VkPresentModeKHR mode) {
+    for (uint32_t i = 0; i < ARRAY_COUNT(presentModeNames); i++) {
+        if (presentModeNames[i].mode == mode) return presentModeNames[i].name;
+    }
+    return "unknown";
+}
+
+bool parsePresentMode(const char* name, VkPresentModeKHR* mode) {
+    for (uint32_t i = 0; i < ARRAY_COUNT(presentModeNames); i++) {
+        if (strcmp(presentModeNames[i].name, name) == 0) {
+            *mode = presentModeNames[i].mode;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isPresentModeSupported(VkPresentModeKHR* modes, uint32_t numModes, VkPresentModeKHR mode) {
+    for (uint32_t i = 0; i < numModes; i++) {
+        if (modes[i] == mode) return true;
+    }
+    return false;
+}
+
+// picks the requested mode if the surface supports it, otherwise the closest
+// alternative with the same tearing/latency tradeoff and finally FIFO (always supported)
+static VkPresentModeKHR selectPresentMode(VulkanContext* context, VkSurfaceKHR surface, VkPresentModeKHR requested) {
+    uint32_t numModes = 0;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(context->physicalDevice, surface, &numModes, NULL);
+
+    VkPresentModeKHR* modes = malloc(sizeof(VkPresentModeKHR) * numModes);
+    if (!modes) {
+        fprintf(stderr, "Failed to allocate memory for present modes!\n");
+        return VK_PRESENT_MODE_FIFO_KHR;
+    }
+    vkGetPhysicalDeviceSurfacePresentModesKHR(context->physicalDevice, surface, &numModes, modes);
+
+    VkPresentModeKHR fallbacks[2] = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_KHR };
+    switch (requested) {
+        case VK_PRESENT_MODE_MAILBOX_KHR: fallbacks[0] = VK_PRESENT_MODE_IMMEDIATE_KHR; break;
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: fallbacks[0] = VK_PRESENT_MODE_MAILBOX_KHR; break;
+        default: break;
+    }
+
+    VkPresentModeKHR result = VK_PRESENT_MODE_FIFO_KHR;
+    if (isPresentModeSupported(modes, numModes, requested)) {
+        result = requested;
+    }
+    else if (isPresentModeSupported(modes, numModes, fallbacks[0])) {
+        result = fallbacks[0];
+    }
+
+    if (result != requested) {
+        fprintf(stderr, "Present mode %s not supported, falling back to %s!\n",
+                presentModeName(requested), presentModeName(result));
+    }
+
+    free(modes);
+    return result;
+}
+
+VulkanSwapchain createSwapchain(GLFWwindow* window, VulkanContext* context, VkSurfaceKHR surface, VkImageUsageFlags usage,
+        VkPresentModeKHR presentMode, uint32_t imageCount, VulkanSwapchain* oldSwapchain) {
     VulkanSwapchain result = {0};
 
     VkBool32 supportsPresent = 0;
@@ -50,10 +123,30 @@ VulkanSwapchain createSwapchain(GLFWwindow* window, VulkanContext* context, VkSu
         surfaceCapabilities.currentExtent.height = height;
     }
 
+    // maxImageCount of 0 means there is no upper limit
+    uint32_t minImageCount = imageCount;
+    if (minImageCount < surfaceCapabilities.minImageCount) {
+        minImageCount = surfaceCapabilities.minImageCount;
+    }
+    if (surfaceCapabilities.maxImageCount > 0 && minImageCount > surfaceCapabilities.maxImageCount) {
+        minImageCount = surfaceCapabilities.maxImageCount;
+    }
+    if (minImageCount != imageCount) {
+        fprintf(stderr, "Swapchain image count %u not supported, using %u!\n", imageCount, minImageCount);
+    }
+
+    presentMode = selectPresentMode(context, surface, presentMode);
+
+    if ((usage & surfaceCapabilities.supportedUsageFlags) != usage) {
+        fprintf(stderr, "Swapchain image usage 0x%x not supported, using 0x%x!\n",
+                usage, usage & surfaceCapabilities.supportedUsageFlags);
+        usage &= surfaceCapabilities.supportedUsageFlags;
+    }
+
     VkSwapchainCreateInfoKHR createInfo = {0};
     createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
     createInfo.surface = surface;
-    createInfo.minImageCount = 3;
+    createInfo.minImageCount = minImageCount;
     createInfo.imageFormat = format;
     createInfo.imageColorSpace = colorSpace;
     createInfo.imageExtent = surfaceCapabilities.currentExtent;
@@ -62,7 +155,7 @@ VulkanSwapchain createSwapchain(GLFWwindow* window, VulkanContext* context, VkSu
     createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
     createInfo.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    createInfo.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    createInfo.presentMode = presentMode;
     createInfo.oldSwapchain = oldSwapchain ? oldSwapchain->swapchain : 0;
 
     if (surfaceCapabilities.supportedTransforms & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR) {
@@ -79,6 +172,8 @@ VulkanSwapchain createSwapchain(GLFWwindow* window, VulkanContext* context, VkSu
     }
 
     result.format = format;
+    result.presentMode = presentMode;
+    result.usage = usage;
     result.width = surfaceCapabilities.currentExtent.width;
     result.height = surfaceCapabilities.currentExtent.height;
 
@@ -0,0 +1,94 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan_core.h>
+
+#include "../include/vulkan_base.h"
+
+bool createQueueTimeline(VulkanContext* context, VulkanQueue* queue) {
+    VkSemaphoreTypeCreateInfo typeInfo = {0};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo createInfo = {0};
+    createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    createInfo.pNext = &typeInfo;
+
+    if (vkCreateSemaphore(context->device, &createInfo, NULL, &queue->timeline) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create timeline semaphore!\n");
+        return false;
+    }
+
+    queue->timelineValue = 0;
+    return true;
+}
+
+void destroyQueueTimeline(VulkanContext* context, VulkanQueue* queue) {
+    vkDestroySemaphore(context->device, queue->timeline, NULL);
+    queue->timeline = VK_NULL_HANDLE;
+}
+
+uint64_t getCompletedTimelineValue(VulkanContext* context, VulkanQueue* queue) {
+    uint64_t value = 0;
+    if (vkGetSemaphoreCounterValue(context->device, queue->timeline, &value) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to get timeline semaphore value!\n");
+    }
+    return value;
+}
+
+bool waitForTimelineValue(VulkanContext* context, VulkanQueue* queue, uint64_t value, uint64_t timeout) {
+    // value 0 is the initial value, nothing to wait for
+    if (value == 0) return true;
+
+    VkSemaphoreWaitInfo waitInfo = {0};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &queue->timeline;
+    waitInfo.pValues = &value;
+
+    if (vkWaitSemaphores(context->device, &waitInfo, timeout) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to wait for timeline value %lu!\n", value);
+        return false;
+    }
+    return true;
+}
+
+// Submits one command buffer and signals the next value on the queue timeline.
+// The binary semaphores are optional and only needed to talk to the swapchain,
+// everything else (other queues, the cpu) waits on the returned timeline value.
+uint64_t submitToQueue(VulkanContext* context, VulkanQueue* queue, VkCommandBuffer commandBuffer,
+        VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage, VkSemaphore signalSemaphore) {
+    uint64_t signalValue = queue->timelineValue + 1;
+
+    VkSemaphore signalSemaphores[2] = { queue->timeline, signalSemaphore };
+    uint64_t signalValues[2] = { signalValue, 0 }; // value is ignored for binary semaphores
+    uint64_t waitValue = 0;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {0};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = waitSemaphore ? 1 : 0;
+    timelineInfo.pWaitSemaphoreValues = &waitValue;
+    timelineInfo.signalSemaphoreValueCount = signalSemaphore ? 2 : 1;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+
+    VkSubmitInfo submitInfo = {0};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.waitSemaphoreCount = waitSemaphore ? 1 : 0;
+    submitInfo.pWaitSemaphores = &waitSemaphore;
+    submitInfo.pWaitDstStageMask = &waitStage;
+    submitInfo.signalSemaphoreCount = signalSemaphore ? 2 : 1;
+    submitInfo.pSignalSemaphores = signalSemaphores;
+
+    if (vkQueueSubmit(queue->queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to submit to queue!\n");
+        return 0;
+    }
+
+    queue->timelineValue = signalValue;
+    return signalValue;
+}
@@ -24,7 +24,7 @@ void uploadDataToBuffer(VulkanContext *context, VulkanBuffer *buffer, void *data
     VulkanBuffer stagingBuffer;
 
     createBuffer(context, &stagingBuffer, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VULKAN_MEMORY_STAGING);
     void* mapped;
     if (vkMapMemory(context->device, stagingBuffer.memory, 0, size, 0, &mapped) != VK_SUCCESS) {
         fprintf(stderr, "Failed to map memory for vulkan buffer!\n");
@@ -71,17 +71,15 @@ void uploadDataToBuffer(VulkanContext *context, VulkanBuffer *buffer, void *data
         return;
     }
 
-    VkSubmitInfo subInfo = {0};
-    subInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    subInfo.commandBufferCount = 1;
-    subInfo.pCommandBuffers = &commandBuffer;
-
-    if (vkQueueSubmit(queue->queue, 1, &subInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+    uint64_t uploadValue = submitToQueue(context, queue, commandBuffer, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+    if (!uploadValue) {
         fprintf(stderr, "Failed to submit queue for staging buffer!\n");
         return;
     }
+    buffer->lastUse = uploadValue;
 
-    if (vkQueueWaitIdle(queue->queue) != VK_SUCCESS) {
+    // only waits for the copy, not for frames that are still in flight on the queue
+    if (!waitForTimelineValue(context, queue, uploadValue, UINT64_MAX)) {
         fprintf(stderr, "Failed to wait for queue in staging buffer!\n");
         return;
     }
@@ -92,7 +90,7 @@ void uploadDataToBuffer(VulkanContext *context, VulkanBuffer *buffer, void *data
 #endif
 }
 
-uint32_t findMemoryType(VulkanContext* context, uint32_t typeFilter, VkMemoryPropertyFlags memoryProperties) {
+static uint32_t findMemoryTypeIndex(VulkanContext* context, uint32_t typeFilter, VkMemoryPropertyFlags memoryProperties) {
     VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
     vkGetPhysicalDeviceMemoryProperties(context->physicalDevice, &deviceMemoryProperties);
 
@@ -106,14 +104,44 @@ uint32_t findMemoryType(VulkanContext* context, uint32_t typeFilter, VkMemoryPro
         }
     }
 
-    // no matching type found
-    fprintf(stderr, "Failed to find matching memory type!\n");
     return UINT32_MAX;
 }
 
+uint32_t findMemoryType(VulkanContext* context, uint32_t typeFilter, VkMemoryPropertyFlags memoryProperties) {
+    uint32_t memoryIndex = findMemoryTypeIndex(context, typeFilter, memoryProperties);
+    if (memoryIndex == UINT32_MAX) {
+        // no matching type found
+        fprintf(stderr, "Failed to find matching memory type!\n");
+    }
+    return memoryIndex;
+}
+
+bool hasMemoryType(VulkanContext* context, uint32_t typeFilter, VkMemoryPropertyFlags memoryProperties) {
+    return findMemoryTypeIndex(context, typeFilter, memoryProperties) != UINT32_MAX;
+}
+
+VkImageAspectFlags getImageAspect(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
 void createBuffer(VulkanContext *context, VulkanBuffer *buffer, uint64_t size,
-        VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryProperties) {
+        VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryProperties, VulkanMemoryCategory category) {
     
+    buffer->lastUse = 0;
+    buffer->memory = VK_NULL_HANDLE;
+    buffer->allocation = (VulkanAllocationInfo){0};
+
     VkBufferCreateInfo createInfo = {0};
     createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     createInfo.size = size;
@@ -138,10 +166,17 @@ void createBuffer(VulkanContext *context, VulkanBuffer *buffer, uint64_t size,
     alloInfo.memoryTypeIndex = memoryIndex;
 
     if (vkAllocateMemory(context->device, &alloInfo, NULL, &buffer->memory) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to allocate vulkan memory for buffer!\n");
+        fprintf(stderr, "Failed to allocate %lu bytes of vulkan memory for %s buffer!\n",
+                memoryRequirements.size, memoryCategoryName(category));
+        printMemorySnapshot(context, stderr);
         return;
     }
 
+    buffer->allocation.size = memoryRequirements.size;
+    buffer->allocation.memoryTypeIndex = memoryIndex;
+    buffer->allocation.category = category;
+    trackAllocation(context, &buffer->allocation);
+
     if (vkBindBufferMemory(context->device, buffer->buffer, buffer->memory, 0) != VK_SUCCESS) {
         fprintf(stderr, "Failed to bind buffer memory!\n");
         return;
@@ -153,12 +188,20 @@ void createBuffer(VulkanContext *context, VulkanBuffer *buffer, uint64_t size,
 void destroyBuffer(VulkanContext *context, VulkanBuffer *buffer) {
     vkDestroyBuffer(context->device, buffer->buffer, NULL);
 
+    if (buffer->allocation.size) {
+        untrackAllocation(context, &buffer->allocation);
+    }
+
     // Assumes that the buffer owns its own memory block
     vkFreeMemory(context->device, buffer->memory, NULL);
 }
 
 void createImage(VulkanContext *context, VulkanImage *image, uint32_t width, uint32_t height,
-                 VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits sampleCount) {
+                 VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits sampleCount,
+                 VulkanMemoryCategory category) {
+    image->lastUse = 0;
+    image->allocation = (VulkanAllocationInfo){0};
+
     {
         VkImageCreateInfo createInfo = {0};
         createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -184,24 +227,38 @@ void createImage(VulkanContext *context, VulkanImage *image, uint32_t width, uin
     VkMemoryRequirements memoryRequirements;
     vkGetImageMemoryRequirements(context->device, image->image, &memoryRequirements);
 
+    // Transient attachments never leave tile memory on tilers, lazily allocated
+    // memory lets the driver skip backing them at all
+    uint32_t memoryIndex = UINT32_MAX;
+    if (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) {
+        memoryIndex = findMemoryTypeIndex(context, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+    }
+    if (memoryIndex == UINT32_MAX) {
+        memoryIndex = findMemoryType(context, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+
     VkMemoryAllocateInfo allocInfo = {0};
     allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
     allocInfo.allocationSize = memoryRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(context, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    allocInfo.memoryTypeIndex = memoryIndex;
     if (vkAllocateMemory(context->device, &allocInfo, NULL, &image->memory) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to allocate memory for image!\n");
+        fprintf(stderr, "Failed to allocate %lu bytes of memory for %s image!\n",
+                memoryRequirements.size, memoryCategoryName(category));
+        printMemorySnapshot(context, stderr);
         exit(-1);
     }
 
+    image->allocation.size = memoryRequirements.size;
+    image->allocation.memoryTypeIndex = memoryIndex;
+    image->allocation.category = category;
+    trackAllocation(context, &image->allocation);
+
     if (vkBindImageMemory(context->device, image->image, image->memory, 0) != VK_SUCCESS) {
         fprintf(stderr, "Failed to bind memory!\n");
         exit(-1);
     }
 
-    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
-    if (format == VK_FORMAT_D32_SFLOAT) {
-        aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
-    }
+    VkImageAspectFlags aspect = getImageAspect(format);
 
     {
         VkImageViewCreateInfo createInfo = {0};
@@ -222,12 +279,36 @@ void createImage(VulkanContext *context, VulkanImage *image, uint32_t width, uin
 }
 
 void destroyImage(VulkanContext *context, VulkanImage *image) {
+    if (image->allocation.size) {
+        untrackAllocation(context, &image->allocation);
+    }
+
     vkDestroyImageView(context->device, image->view, NULL);
     vkDestroyImage(context->device, image->image, NULL);
     vkFreeMemory(context->device, image->memory, NULL);
 }
 
 
+void cmdTransitionImage(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect,
+                        VkImageLayout oldLayout, VkImageLayout newLayout,
+                        VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                        VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkImageMemoryBarrier imageBarrier = {0};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.oldLayout = oldLayout;
+    imageBarrier.newLayout = newLayout;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = image;
+    imageBarrier.subresourceRange.aspectMask = aspect;
+    imageBarrier.subresourceRange.levelCount = 1;
+    imageBarrier.subresourceRange.layerCount = 1;
+    imageBarrier.srcAccessMask = srcAccess;
+    imageBarrier.dstAccessMask = dstAccess;
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, 0, 0, 0, 1, &imageBarrier);
+}
+
 void uploadDataToImage(VulkanContext *context, VulkanImage *image, void* data,
                        uint32_t size, uint32_t width, uint32_t height,
                        VkImageLayout finalLayout, VkAccessFlags dstAccessMask) {
@@ -237,7 +318,7 @@ void uploadDataToImage(VulkanContext *context, VulkanImage *image, void* data,
     VulkanBuffer stagingBuffer;
 
     createBuffer(context, &stagingBuffer, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VULKAN_MEMORY_STAGING);
     void* mapped;
     if (vkMapMemory(context->device, stagingBuffer.memory, 0, size, 0, &mapped) != VK_SUCCESS) {
         fprintf(stderr, "Failed to map memory for vulkan buffer!\n");
@@ -328,17 +409,14 @@ void uploadDataToImage(VulkanContext *context, VulkanImage *image, void* data,
         exit(-1);
     }
 
-    VkSubmitInfo subInfo = {0};
-    subInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    subInfo.commandBufferCount = 1;
-    subInfo.pCommandBuffers = &commandBuffer;
-
-    if (vkQueueSubmit(queue->queue, 1, &subInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+    uint64_t uploadValue = submitToQueue(context, queue, commandBuffer, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+    if (!uploadValue) {
         fprintf(stderr, "Failed to submit queue for staging buffer!\n");
         exit(-1);
     }
+    image->lastUse = uploadValue;
 
-    if (vkQueueWaitIdle(queue->queue) != VK_SUCCESS) {
+    if (!waitForTimelineValue(context, queue, uploadValue, UINT64_MAX)) {
         fprintf(stderr, "Failed to wait for queue in staging buffer!\n");
         exit(-1);
     }
@@ -348,3 +426,12 @@ void uploadDataToImage(VulkanContext *context, VulkanImage *image, void* data,
 
 }
 
+// FNV-1a, chain calls starting from VULKAN_HASH_SEED
+uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}